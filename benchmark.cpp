@@ -0,0 +1,791 @@
+// Throughput benchmark: fefu::hash_map against std::unordered_map.
+//
+//   g++ -std=c++17 -O2 -march=native -pthread benchmark.cpp -o benchmark
+//   ./benchmark [max_size] [filter]
+//
+// Built with -std=c++20 it also times coroutine-interleaved lookups.
+//
+// max_size caps the table sizes (1K, 10K, ... 100M; default 1M), filter prints
+// only the lines whose operation name contains it. On Linux cache and branch
+// misses are read with perf_event_open when the kernel allows it.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "hash_map.hpp"
+#include "small_hash_map.hpp"
+#include "static_hash_map.hpp"
+#include "perfect_hash_map.hpp"
+#include "dense_hash_map.hpp"
+#include "compact_hash_map.hpp"
+#include "cow_hash_map.hpp"
+#include "hash_map_async.hpp"
+#include "hash_join.hpp"
+
+namespace {
+
+	// hardware counters.
+
+	class perf_counter {
+	public:
+		explicit perf_counter(uint64_t config) {
+#if defined(__linux__)
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+			(void)config;
+#endif
+		}
+
+		~perf_counter() {
+#if defined(__linux__)
+			if (fd_ >= 0) {
+				close(fd_);
+			}
+#endif
+		}
+
+		perf_counter(const perf_counter&) = delete;
+		perf_counter& operator=(const perf_counter&) = delete;
+
+		bool available() const { return fd_ >= 0; }
+
+		void start() {
+#if defined(__linux__)
+			if (fd_ >= 0) {
+				ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		uint64_t stop() {
+			uint64_t value = 0;
+#if defined(__linux__)
+			if (fd_ >= 0) {
+				ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(fd_, &value, sizeof(value)) != sizeof(value)) {
+					value = 0;
+				}
+			}
+#endif
+			return value;
+		}
+
+	private:
+		int fd_ = -1;
+	};
+
+#if defined(__linux__)
+	perf_counter cache_misses(PERF_COUNT_HW_CACHE_MISSES);
+	perf_counter branch_misses(PERF_COUNT_HW_BRANCH_MISSES);
+#else
+	perf_counter cache_misses(0);
+	perf_counter branch_misses(0);
+#endif
+
+	const char* filter = nullptr;
+	uint64_t sink = 0;
+
+	/// Runs body once, then prints the time and counters per operation.
+	/// Later steps depend on the earlier ones, so filtered steps still run.
+	template <typename Body>
+	void measure(const char* map_name, const char* key_name, std::size_t size, const char* op, std::size_t ops, Body&& body) {
+		if (filter != nullptr && std::strstr(op, filter) == nullptr) {
+			body();
+			return;
+		}
+
+		cache_misses.start();
+		branch_misses.start();
+		auto started = std::chrono::steady_clock::now();
+		body();
+		auto elapsed = std::chrono::steady_clock::now() - started;
+		uint64_t cmiss = cache_misses.stop();
+		uint64_t bmiss = branch_misses.stop();
+
+		double n = static_cast<double>(ops == 0 ? 1 : ops);
+		std::printf("%-15s %-7s %10zu %-16s %9.2f ns/op", map_name, key_name, size, op,
+			std::chrono::duration<double, std::nano>(elapsed).count() / n);
+		if (cache_misses.available()) {
+			std::printf(" %7.3f cache-miss/op %7.3f branch-miss/op", cmiss / n, bmiss / n);
+		}
+		std::printf("\n");
+		std::fflush(stdout);
+	}
+
+	/// Prints the memory a table uses per element, in the measure() layout.
+	void report_memory(const char* map_name, const char* key_name, std::size_t size, const char* op, std::size_t bytes) {
+		if (filter != nullptr && std::strstr(op, filter) == nullptr) {
+			return;
+		}
+		std::printf("%-15s %-7s %10zu %-16s %9.2f B/entry\n", map_name, key_name, size, op,
+			static_cast<double>(bytes) / static_cast<double>(size == 0 ? 1 : size));
+		std::fflush(stdout);
+	}
+
+	// key types.
+
+	struct key64 {
+		uint64_t parts[8];
+
+		bool operator==(const key64& other) const {
+			return std::memcmp(parts, other.parts, sizeof(parts)) == 0;
+		}
+	};
+
+	struct key64_hash {
+		std::size_t operator()(const key64& k) const {
+			uint64_t h = 0;
+			for (uint64_t part : k.parts) {
+				h = (h ^ part) * 0x9E3779B97F4A7C15ull;
+			}
+			return static_cast<std::size_t>(h ^ (h >> 32));
+		}
+	};
+
+	// make(i, x) builds the i-th key from the random number x; std_hasher is
+	// the standard library hash, fast_hasher the fefu::hash counterpart.
+
+	struct uint64_keys {
+		using key_type = uint64_t;
+		using std_hasher = std::hash<uint64_t>;
+		using fast_hasher = fefu::hash<uint64_t>;
+		static const char* name() { return "uint64"; }
+		static uint64_t make(std::size_t, uint64_t x) { return x; }
+	};
+
+	/// Keys 4096 apart: identity hashes put them all in a few slots of a
+	/// power-of-two table unless the map mixes them.
+	struct strided_keys {
+		using key_type = uint64_t;
+		using std_hasher = std::hash<uint64_t>;
+		using fast_hasher = fefu::hash<uint64_t>;
+		static const char* name() { return "strided"; }
+		static uint64_t make(std::size_t i, uint64_t x) { return ((i << 1) | (x & 1)) << 12; }
+	};
+
+	struct string_keys {
+		using key_type = std::string;
+		using std_hasher = std::hash<std::string>;
+		using fast_hasher = fefu::hash<std::string>;
+		static const char* name() { return "string"; }
+		static std::string make(std::size_t, uint64_t x) { return "key:" + std::to_string(x) + ":payload"; }
+	};
+
+	struct key64_keys {
+		using key_type = key64;
+		using std_hasher = key64_hash;
+		using fast_hasher = key64_hash;
+		static const char* name() { return "key64"; }
+		static key64 make(std::size_t, uint64_t x) {
+			key64 k;
+			for (int i = 0; i < 8; i++) {
+				k.parts[i] = x * (i + 1);
+			}
+			return k;
+		}
+	};
+
+	// mapped value types for the emplace workloads; arg(x) is what is passed
+	// to try_emplace, make(x) a finished value.
+
+	struct move_only_values {
+		using value_type = std::unique_ptr<uint64_t>;
+		static const char* name() { return "move"; }
+		static value_type arg(uint64_t x) { return std::make_unique<uint64_t>(x); }
+		static value_type make(uint64_t x) { return std::make_unique<uint64_t>(x); }
+		static uint64_t read(const value_type& v) { return *v; }
+	};
+
+	/// Value whose constructor fills 256 bytes, so every throwaway
+	/// construction shows up in the timings.
+	struct expensive_value {
+		uint64_t data[32];
+
+		explicit expensive_value(uint64_t seed) {
+			for (uint64_t& d : data) {
+				seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+				d = seed;
+			}
+		}
+	};
+
+	struct expensive_values {
+		using value_type = expensive_value;
+		static const char* name() { return "heavy"; }
+		static uint64_t arg(uint64_t x) { return x; }
+		static value_type make(uint64_t x) { return expensive_value(x); }
+		static uint64_t read(const value_type& v) { return v.data[0]; }
+	};
+
+	// workloads.
+
+	/// Erases the elements matching pred, with std::unordered_map's iterator
+	/// loop or fefu::hash_map's erase_if.
+	template <typename Map, typename Pred>
+	std::size_t sweep(Map& map, Pred pred) {
+		std::size_t erased = 0;
+		for (auto iter = map.begin(); iter != map.end(); ) {
+			if (pred(*iter)) {
+				iter = map.erase(iter);
+				erased++;
+			} else {
+				++iter;
+			}
+		}
+		return erased;
+	}
+
+	template <typename K, typename T, typename H, typename P, typename A, typename M, typename S, typename G, typename Pred>
+	std::size_t sweep(fefu::hash_map<K, T, H, P, A, M, S, G>& map, Pred pred) {
+		return erase_if(map, pred);
+	}
+
+	/// Bytes held by a table's slots and control words.
+	template <typename K, typename T, typename H, typename P, typename A, typename M, typename S, typename G>
+	std::size_t table_bytes(const fefu::hash_map<K, T, H, P, A, M, S, G>& map) {
+		return map.bucket_count() * sizeof(typename fefu::hash_map<K, T, H, P, A, M, S, G>::value_type) +
+			M::words(map.bucket_count()) * sizeof(typename M::word_type);
+	}
+
+	template <typename K, typename T, typename H, typename P, typename A>
+	std::size_t table_bytes(const fefu::dense_hash_map<K, T, H, P, A>& map) {
+		return map.bucket_count() * sizeof(typename fefu::dense_hash_map<K, T, H, P, A>::value_type);
+	}
+
+	template <typename V, unsigned Bits>
+	std::size_t table_bytes(const fefu::compact_hash_map<V, Bits>& map) {
+		return map.memory_usage();
+	}
+
+	/// freeze() and lookups on the frozen copy; only fefu::hash_map has them.
+	template <typename Map, typename Key>
+	void run_frozen(const char*, const char*, const Map&, const std::vector<Key>&, const std::vector<Key>&) {
+	}
+
+	template <typename K, typename T, typename H, typename P, typename A, typename M, typename S, typename G>
+	void run_frozen(const char* map_name, const char* key_name, const fefu::hash_map<K, T, H, P, A, M, S, G>& map,
+		const std::vector<K>& keys, const std::vector<K>& missing) {
+		std::size_t size = keys.size();
+		report_memory(map_name, key_name, size, "memory", table_bytes(map));
+
+		fefu::frozen_hash_map<K, T, H, P> frozen;
+		measure(map_name, key_name, size, "freeze", size, [&] {
+			frozen = map.freeze();
+		});
+		report_memory(map_name, key_name, size, "frozen_memory", frozen.memory_usage());
+
+		measure(map_name, key_name, size, "frozen_find_hit", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += frozen.find(keys[i])->second;
+			}
+		});
+
+		measure(map_name, key_name, size, "frozen_find_miss", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += frozen.find(missing[i]) == frozen.end();
+			}
+		});
+	}
+
+	template <typename Map, typename Traits>
+	void run_suite(const char* map_name, std::size_t size) {
+		using traits = Traits;
+		using Key = typename Traits::key_type;
+		const char* key_name = traits::name();
+
+		std::mt19937_64 rng(size);
+		std::vector<Key> keys;
+		std::vector<Key> missing;
+		keys.reserve(size);
+		missing.reserve(size);
+		for (std::size_t i = 0; i < size; i++) {
+			uint64_t x = rng();
+			keys.push_back(traits::make(i, x | 1));
+			missing.push_back(traits::make(i, x & ~static_cast<uint64_t>(1)));
+		}
+
+		Map map;
+		measure(map_name, key_name, size, "insert", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				map.insert({ keys[i], i });
+			}
+		});
+
+		measure(map_name, key_name, size, "find_hit", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.find(keys[i])->second;
+			}
+		});
+
+		measure(map_name, key_name, size, "find_miss", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.find(missing[i]) == map.end();
+			}
+		});
+
+		run_frozen(map_name, key_name, map, keys, missing);
+
+		measure(map_name, key_name, size, "iterate", size, [&] {
+			for (auto iter = map.begin(); iter != map.end(); ++iter) {
+				sink += iter->second;
+			}
+		});
+
+		measure(map_name, key_name, size, "copy", size, [&] {
+			Map copy(map);
+			sink += copy.size();
+		});
+
+		{
+			// two per-thread style partial maps that share a quarter of their keys.
+			Map left, right;
+			for (std::size_t i = 0; i < size; i++) {
+				if (i % 2 == 0 || i % 4 == 1) {
+					left.insert({ keys[i], i });
+				}
+				if (i % 2 == 1) {
+					right.insert({ keys[i], i });
+				}
+			}
+			measure(map_name, key_name, size, "merge", right.size(), [&] {
+				left.merge(right);
+				sink += left.size() + right.size();
+			});
+		}
+
+		for (int write_percent : { 10, 50 }) {
+			char op[32];
+			std::snprintf(op, sizeof(op), "mixed_w%d", write_percent);
+			std::mt19937_64 mix_rng(write_percent);
+			measure(map_name, key_name, size, op, size, [&] {
+				for (std::size_t i = 0; i < size; i++) {
+					std::size_t k = mix_rng() % size;
+					if (static_cast<int>(mix_rng() % 100) < write_percent) {
+						map[keys[k]] = i;
+					} else {
+						sink += map.count(keys[k]);
+					}
+				}
+			});
+		}
+
+		measure(map_name, key_name, size, "erase_churn", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				map.erase(keys[i]);
+				map.insert({ missing[i], i });
+			}
+		});
+
+		measure(map_name, key_name, size, "erase_if_30", size, [&] {
+			sink += sweep(map, [](const auto& x) { return x.second % 10 < 3; });
+		});
+
+		measure(map_name, key_name, size, "rehash", size, [&] {
+			map.rehash(map.bucket_count() * 2);
+		});
+	}
+
+	/// try_emplace, emplace and insert_or_assign with values that are costly
+	/// to build or can only be moved; hits must not construct anything.
+	template <typename Map, typename Values>
+	void run_value_suite(const char* map_name, std::size_t size) {
+		const char* value_name = Values::name();
+
+		std::mt19937_64 rng(size);
+		std::vector<uint64_t> keys;
+		keys.reserve(size);
+		for (std::size_t i = 0; i < size; i++) {
+			keys.push_back(rng());
+		}
+
+		Map map;
+		measure(map_name, value_name, size, "try_emplace", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				map.try_emplace(keys[i], Values::arg(i));
+			}
+		});
+
+		measure(map_name, value_name, size, "try_emplace_hit", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += Values::read(map.try_emplace(keys[i], Values::arg(i)).first->second);
+			}
+		});
+
+		measure(map_name, value_name, size, "emplace_hit", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.emplace(keys[i], Values::make(i)).second;
+			}
+		});
+
+		measure(map_name, value_name, size, "insert_or_assign", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.insert_or_assign(keys[i] ^ (i & 1), Values::make(i)).second;
+			}
+		});
+	}
+
+	template <typename Values>
+	void run_values(std::size_t size) {
+		using V = typename Values::value_type;
+		run_value_suite<fefu::hash_map<uint64_t, V, fefu::hash<uint64_t>>, Values>("fefu+fefu::hash", size);
+		run_value_suite<std::unordered_map<uint64_t, V>, Values>("std::unordered", size);
+	}
+
+	/// A scratch map sized for size keys that is filled with 8 keys and
+	/// cleared over and over, as request-scoped code does.
+	template <typename Map>
+	void run_scratch(const char* map_name, std::size_t size) {
+		const std::size_t rounds = 10000;
+		Map map;
+		map.reserve(size);
+		measure(map_name, "uint64", size, "scratch_clear", rounds, [&] {
+			for (std::size_t r = 0; r < rounds; r++) {
+				for (uint64_t i = 0; i < 8; i++) {
+					map[r * 8 + i] = i;
+				}
+				sink += map.size();
+				map.clear();
+			}
+		});
+	}
+
+	void run_scratch_maps(std::size_t size) {
+		using generation_map = fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>, std::equal_to<uint64_t>,
+			fefu::allocator<std::pair<const uint64_t, uint64_t>>, fefu::generation_metadata>;
+		run_scratch<fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>>>("fefu+fefu::hash", size);
+		run_scratch<generation_map>("fefu+generation", size);
+		run_scratch<std::unordered_map<uint64_t, uint64_t>>("std::unordered", size);
+	}
+
+	/// Builds one short-lived map of 6 keys per element and reads it back,
+	/// the pattern of per-request scratch maps.
+	template <typename Map>
+	void run_small(const char* map_name, std::size_t size) {
+		measure(map_name, "uint64", size, "small_maps", size * 12, [&] {
+			for (std::size_t r = 0; r < size; r++) {
+				Map map;
+				for (uint64_t i = 0; i < 6; i++) {
+					map[r + i * 7919] = i;
+				}
+				for (uint64_t i = 0; i < 6; i++) {
+					sink += map.find(r + i * 7919)->second;
+				}
+			}
+		});
+	}
+
+	void run_small_maps(std::size_t size) {
+		run_small<fefu::small_hash_map<uint64_t, uint64_t, 8, fefu::hash<uint64_t>>>("fefu::small", size);
+		run_small<fefu::static_hash_map<uint64_t, uint64_t, 16>>("fefu::static", size);
+		run_small<fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>>>("fefu+fefu::hash", size);
+		run_small<std::unordered_map<uint64_t, uint64_t>>("std::unordered", size);
+	}
+
+	constexpr std::size_t keyword_count = 256;
+
+	constexpr uint64_t keyword(std::size_t i) {
+		return i * 0x9E3779B97F4A7C15ull;
+	}
+
+	constexpr fefu::perfect_hash_map<uint64_t, uint64_t, keyword_count> make_keywords() {
+		std::pair<uint64_t, uint64_t> entries[keyword_count] = {};
+		for (std::size_t i = 0; i < keyword_count; i++) {
+			entries[i].first = keyword(i);
+			entries[i].second = i;
+		}
+		return fefu::perfect_hash_map<uint64_t, uint64_t, keyword_count>(entries);
+	}
+
+	/// Looks up a fixed set of 256 keys, the keyword or opcode table case;
+	/// size is the number of lookups.
+	template <typename Map>
+	void run_keywords(const char* map_name, const Map& map, std::size_t size) {
+		measure(map_name, "uint64", size, "keyword_find", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.find(keyword(i % keyword_count))->second;
+			}
+		});
+	}
+
+	void run_keyword_maps(std::size_t size) {
+		static constexpr auto perfect = make_keywords();
+		fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>> map;
+		for (std::size_t i = 0; i < keyword_count; i++) {
+			map[keyword(i)] = i;
+		}
+		run_keywords("fefu::perfect", perfect, size);
+		run_keywords("fefu+fefu::hash", map, size);
+	}
+
+	/// Insert, lookups and churn on uint64 keys, for maps that can't run the
+	/// full suite.
+	template <typename Map>
+	void run_lookups(const char* map_name, Map map, std::size_t size) {
+		std::mt19937_64 rng(size);
+		std::vector<uint64_t> keys;
+		std::vector<uint64_t> missing;
+		for (std::size_t i = 0; i < size; i++) {
+			uint64_t x = rng() >> 1;
+			keys.push_back(x | 1);
+			missing.push_back(x & ~static_cast<uint64_t>(1));
+		}
+
+		measure(map_name, "uint64", size, "insert", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				map.insert({ keys[i], i });
+			}
+		});
+		measure(map_name, "uint64", size, "find_hit", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.find(keys[i])->second;
+			}
+		});
+		measure(map_name, "uint64", size, "find_miss", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.find(missing[i]) == map.end();
+			}
+		});
+		report_memory(map_name, "uint64", size, "memory", table_bytes(map));
+		measure(map_name, "uint64", size, "erase_churn", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				map.erase(keys[i]);
+				map.insert({ missing[i], i });
+			}
+		});
+	}
+
+	void run_dense_maps(std::size_t size) {
+		run_lookups("fefu::dense", fefu::dense_hash_map<uint64_t, uint64_t>(~0ull, ~0ull - 1), size);
+		run_lookups("fefu+fefu::hash", fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>>(), size);
+	}
+
+	/// 64-bit ids to 32-bit values, where the table size is the concern.
+	void run_compact_maps(std::size_t size) {
+		run_lookups("fefu::compact", fefu::compact_hash_map<uint32_t>(), size);
+		run_lookups("fefu+fefu::hash", fefu::hash_map<uint64_t, uint32_t, fefu::hash<uint64_t>>(), size);
+	}
+
+	/// One copy of a size-element map per reader: a deep copy against a
+	/// copy-on-write snapshot, and the clone paid by the first write after it.
+	void run_snapshots(std::size_t size) {
+		using map_type = fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>>;
+		const std::size_t readers = std::max<std::size_t>(1, 10000000 / size);
+		map_type map;
+		for (std::size_t i = 0; i < size; i++) {
+			map.insert({ i, i });
+		}
+		fefu::cow_hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>> cow{ map_type(map) };
+
+		measure("fefu+fefu::hash", "uint64", size, "copy", readers, [&] {
+			for (std::size_t r = 0; r < readers; r++) {
+				map_type copy(map);
+				sink += copy.size();
+			}
+		});
+		measure("fefu::cow", "uint64", size, "copy", readers, [&] {
+			for (std::size_t r = 0; r < readers; r++) {
+				auto copy = cow.snapshot();
+				sink += copy.size();
+			}
+		});
+		measure("fefu::cow", "uint64", size, "copy_write", readers, [&] {
+			for (std::size_t r = 0; r < readers; r++) {
+				auto copy = cow.snapshot();
+				copy[r] = r;
+				sink += copy.size();
+			}
+		});
+	}
+
+	/// Coming back to entries found before: find() again against get() with
+	/// the slot_handle kept from the first lookup.
+	void run_handles(std::size_t size) {
+		fefu::hash_map<std::string, uint64_t, fefu::hash<std::string>> map;
+		std::vector<std::string> keys;
+		for (std::size_t i = 0; i < size; i++) {
+			keys.push_back(string_keys::make(i, i * 0x9e3779b97f4a7c15ull));
+			map.insert({ keys.back(), i });
+		}
+		std::vector<fefu::slot_handle> handles;
+		for (const std::string& k : keys) {
+			handles.push_back(map.handle(map.find(k)));
+		}
+
+		measure("fefu+fefu::hash", "string", size, "refind", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.find(keys[i])->second;
+			}
+		});
+		measure("fefu+fefu::hash", "string", size, "handle_get", size, [&] {
+			for (std::size_t i = 0; i < size; i++) {
+				sink += map.get(handles[i], keys[i])->second;
+			}
+		});
+	}
+
+	/// Equi-join of size build rows with 4 * size probe rows, a quarter of
+	/// which match: one map built and probed serially against hash_join.
+	void run_join(std::size_t size) {
+		std::mt19937_64 rng(size);
+		std::vector<std::pair<uint64_t, uint64_t>> build;
+		std::vector<std::pair<uint64_t, uint64_t>> probe;
+		for (std::size_t i = 0; i < size; i++) {
+			build.push_back({ rng(), i });
+		}
+		for (std::size_t i = 0; i < size * 4; i++) {
+			probe.push_back({ i % 4 == 0 ? build[rng() % size].first : rng(), i });
+		}
+
+		measure("fefu+fefu::hash", "uint64", size, "join_serial", size * 5, [&] {
+			fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>> map;
+			for (const auto& row : build) {
+				map.insert(row);
+			}
+			for (const auto& row : probe) {
+				auto iter = map.find(row.first);
+				if (iter != map.end()) {
+					sink += iter->second ^ row.second;
+				}
+			}
+		});
+
+		std::vector<uint64_t> sums(std::max(1u, std::thread::hardware_concurrency()) * 8, 0);
+		measure("fefu::join", "uint64", size, "join_radix", size * 5, [&] {
+			fefu::hash_join(build, probe, [&](std::size_t worker, uint64_t, uint64_t b, uint64_t p) {
+				sums[worker * 8] += b ^ p;
+			}, fefu::hash_join_options(), fefu::hash<uint64_t>());
+		});
+		for (uint64_t sum : sums) {
+			sink += sum;
+		}
+	}
+
+#if defined(FEFU_HAS_COROUTINES)
+	using chain_map = fefu::hash_map<uint64_t, uint64_t, fefu::hash<uint64_t>>;
+
+	constexpr std::size_t tasks_in_flight = 16;
+
+	/// Requests first, first + stride, ...: each follows length lookups,
+	/// every key being the value found before.
+	fefu::lookup_task follow_chains(const chain_map& map, const std::vector<uint64_t>& keys,
+		std::size_t first, std::size_t stride, std::size_t length) {
+		for (std::size_t r = first; r < keys.size(); r += stride) {
+			uint64_t key = keys[r];
+			for (std::size_t i = 0; i < length; i++) {
+				key = (co_await fefu::async_find(map, key))->second;
+			}
+			sink += key;
+		}
+	}
+
+	/// Dependent lookup chains of 1, 4 and 16 hops, one request after
+	/// another with find() against tasks_in_flight requests interleaved
+	/// with async_find(); both report ns per lookup. Out-of-order execution
+	/// already overlaps the misses of short independent requests, so
+	/// interleaving only pays off once a chain is longer than the CPU can
+	/// look ahead.
+	void run_async(std::size_t size) {
+		std::mt19937_64 rng(size);
+		std::vector<uint64_t> keys;
+		chain_map map;
+		for (std::size_t i = 0; i < size; i++) {
+			keys.push_back(rng());
+		}
+		for (std::size_t i = 0; i < size; i++) {
+			map.insert({ keys[i], keys[rng() % size] });
+		}
+
+		for (std::size_t length : { 1, 4, 16 }) {
+			std::string find_op = "chain" + std::to_string(length) + "_find";
+			std::string async_op = "chain" + std::to_string(length) + "_async";
+			measure("fefu+fefu::hash", "uint64", size, find_op.c_str(), size * length, [&] {
+				for (std::size_t r = 0; r < size; r++) {
+					uint64_t key = keys[r];
+					for (std::size_t i = 0; i < length; i++) {
+						key = map.find(key)->second;
+					}
+					sink += key;
+				}
+			});
+			measure("fefu+fefu::hash", "uint64", size, async_op.c_str(), size * length, [&] {
+				fefu::lookup_scheduler scheduler;
+				for (std::size_t t = 0; t < tasks_in_flight; t++) {
+					scheduler.spawn(follow_chains(map, keys, t, tasks_in_flight, length));
+				}
+				scheduler.run();
+			});
+		}
+	}
+#endif
+
+	template <typename Traits>
+	void run_key(std::size_t size) {
+		using Key = typename Traits::key_type;
+		run_suite<fefu::hash_map<Key, uint64_t, typename Traits::std_hasher>, Traits>("fefu::hash_map", size);
+		run_suite<fefu::hash_map<Key, uint64_t, typename Traits::fast_hasher>, Traits>("fefu+fefu::hash", size);
+		run_suite<std::unordered_map<Key, uint64_t, typename Traits::std_hasher>, Traits>("std::unordered", size);
+	}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	std::size_t max_size = 1000000;
+	if (argc > 1) {
+		max_size = std::strtoull(argv[1], nullptr, 10);
+	}
+	if (argc > 2) {
+		filter = argv[2];
+	}
+
+	if (!cache_misses.available()) {
+		std::printf("# perf_event_open unavailable, hardware counters disabled\n");
+	}
+
+	for (std::size_t size = 1000; size <= max_size && size <= 100000000; size *= 10) {
+		run_key<uint64_keys>(size);
+		run_key<strided_keys>(size);
+		run_key<string_keys>(size);
+		run_key<key64_keys>(size);
+		run_values<move_only_values>(size);
+		run_values<expensive_values>(size);
+		run_scratch_maps(size);
+		run_small_maps(size);
+		run_keyword_maps(size);
+		run_dense_maps(size);
+		run_compact_maps(size);
+		run_snapshots(size);
+		run_handles(size);
+		run_join(size);
+#if defined(FEFU_HAS_COROUTINES)
+		run_async(size);
+#endif
+	}
+
+	// printed so that the timed loops can't be optimized out.
+	std::printf("# sink %llu\n", static_cast<unsigned long long>(sink));
+	return 0;
+}
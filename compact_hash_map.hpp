@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	namespace detail {
+
+		/// Inverse of an odd number modulo 2^64, by Newton's iteration.
+		constexpr uint64_t inverse_odd(uint64_t x) noexcept {
+			uint64_t inv = x;
+			for (int i = 0; i < 5; i++) {
+				inv *= 2 - x * inv;
+			}
+			return inv;
+		}
+
+		/// MurmurHash3's fmix64: a bijection on 64-bit integers, so a key
+		/// can be rebuilt from its hash with unmix64.
+		constexpr uint64_t fmix64(uint64_t x) noexcept {
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdull;
+			x ^= x >> 33;
+			x *= 0xc4ceb9fe1a85ec53ull;
+			x ^= x >> 33;
+			return x;
+		}
+
+		constexpr uint64_t unmix64(uint64_t x) noexcept {
+			x ^= x >> 33;
+			x *= inverse_odd(0xc4ceb9fe1a85ec53ull);
+			x ^= x >> 33;
+			x *= inverse_odd(0xff51afd7ed558ccdull);
+			x ^= x >> 33;
+			return x;
+		}
+
+	}  // namespace detail
+
+	/// Forward iterator over a compact_hash_map; it rebuilds every key from
+	/// the slot, so it hands out (key, value) pairs by value.
+	template <typename Map>
+	class compact_hash_map_iterator {
+		template <typename V, unsigned ValueBits>
+		friend class compact_hash_map;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename Map::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = value_type;
+
+		struct pointer {
+			value_type value;
+
+			const value_type* operator->() const noexcept { return &value; }
+		};
+
+		compact_hash_map_iterator() noexcept = default;
+
+		reference operator*() const { return map_->entry_at(index_); }
+		pointer operator->() const { return pointer{ **this }; }
+
+		// prefix ++
+		compact_hash_map_iterator& operator++() {
+			index_ = map_->next_full(index_ + 1);
+			return *this;
+		}
+		// postfix ++
+		compact_hash_map_iterator operator++(int) {
+			compact_hash_map_iterator result(*this);
+			++(*this);
+			return result;
+		}
+
+		friend bool operator==(const compact_hash_map_iterator& lhs, const compact_hash_map_iterator& rhs) {
+			return lhs.index_ == rhs.index_;
+		}
+		friend bool operator!=(const compact_hash_map_iterator& lhs, const compact_hash_map_iterator& rhs) {
+			return lhs.index_ != rhs.index_;
+		}
+
+	private:
+		compact_hash_map_iterator(const Map* map, std::size_t index) noexcept : map_(map), index_(index) {}
+
+		const Map* map_ = nullptr;
+		std::size_t index_ = 0;
+	};
+
+	/// Memory-lean map from 64-bit keys to unsigned integers of ValueBits
+	/// bits, for tables of hundreds of millions of entries.
+	///
+	/// Keys go through a bijective mix; with 2^q slots the top q bits of the
+	/// mixed key pick the home slot and only the other 64 - q bits are
+	/// stored (quotienting). Each slot packs an 8-bit probe distance, the
+	/// remainder and the value into ValueBits + 72 - q bits of a bit array:
+	/// with 2^30 slots and uint32_t values that is 8 + 34 + 32 = 74 bits,
+	/// 9.25 bytes a slot, or about 10.6 per entry at the maximum load.
+	/// Robin Hood probing with backward-shift deletion keeps probes short
+	/// at the default 0.875 load and leaves no tombstones.
+	template <typename V, unsigned ValueBits = sizeof(V) * 8>
+	class compact_hash_map {
+		static_assert(std::is_integral_v<V> && std::is_unsigned_v<V>, "compact_hash_map stores unsigned integer values");
+		static_assert(ValueBits > 0 && ValueBits <= sizeof(V) * 8, "ValueBits must fit in V");
+
+		template <typename>
+		friend class compact_hash_map_iterator;
+	public:
+		using key_type = uint64_t;
+		using mapped_type = V;
+		using value_type = std::pair<key_type, mapped_type>;
+		using size_type = std::size_t;
+		using const_iterator = compact_hash_map_iterator<compact_hash_map>;
+		using iterator = const_iterator;
+
+		compact_hash_map() : compact_hash_map(8) {}
+
+		///  Tables start at 8 slots.
+		explicit compact_hash_map(size_type n) {
+			allocate(n < 8 ? 8 : n);
+		}
+
+		// size and capacity:
+		bool empty() const noexcept { return length_ == 0; }
+		size_type size() const noexcept { return length_; }
+
+		///  Bytes held by the slot array.
+		size_type memory_usage() const noexcept {
+			return words_.capacity() * sizeof(uint64_t);
+		}
+
+		// iterators.
+		const_iterator begin() const { return const_iterator(this, next_full(0)); }
+		const_iterator end() const noexcept { return const_iterator(this, capacity_); }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const noexcept { return end(); }
+
+		// modifiers.
+		///  Values are cut to ValueBits bits.
+		std::pair<const_iterator, bool> insert(const value_type& x) {
+			size_type index = find_index(x.first);
+			if (index != capacity_) {
+				return { const_iterator(this, index), false };
+			}
+			return { const_iterator(this, add(detail::fmix64(x.first), x.second)), true };
+		}
+
+		template <typename _InputIterator>
+		void insert(_InputIterator first, _InputIterator last) {
+			for (auto iter = first; iter != last; iter++) {
+				this->insert(*iter);
+			}
+		}
+
+		std::pair<const_iterator, bool> insert_or_assign(const key_type& k, mapped_type v) {
+			size_type index = find_index(k);
+			if (index != capacity_) {
+				set_value(index, v);
+				return { const_iterator(this, index), false };
+			}
+			return { const_iterator(this, add(detail::fmix64(k), v)), true };
+		}
+
+		size_type erase(const key_type& x) {
+			size_type index = find_index(x);
+			if (index == capacity_) {
+				return 0;
+			}
+
+			// backward shift: pull the rest of the cluster one slot closer to home.
+			size_type next = (index + 1) & mask_;
+			for (uint64_t d = distance(next); d > 1; d = distance(next)) {
+				write(index, d - 1, remainder(next), value(next));
+				index = next;
+				next = (next + 1) & mask_;
+			}
+			write(index, 0, 0, 0);
+			length_--;
+			return 1;
+		}
+
+		void clear() {
+			std::fill(words_.begin(), words_.end(), 0);
+			length_ = 0;
+		}
+
+		// lookup.
+		const_iterator find(const key_type& x) const { return const_iterator(this, find_index(x)); }
+
+		size_type count(const key_type& x) const {
+			return (find_index(x) != capacity_ ? 1 : 0);
+		}
+
+		bool contains(const key_type& x) const {
+			return (this->count(x) == 1);
+		}
+
+		mapped_type at(const key_type& k) const {
+			size_type index = find_index(k);
+			if (index == capacity_) {
+				throw std::out_of_range("Out of range");
+			}
+			return value(index);
+		}
+
+		// bucket interface.
+		size_type bucket_count() const noexcept { return capacity_; }
+
+		// hash policy.
+		float load_factor() const noexcept { return static_cast<float>(length_) / capacity_; }
+		float max_load_factor() const noexcept { return max_load_factor_; }
+		void max_load_factor(float z) {
+			if (z >= 1.0 || z <= 0.0) {
+				throw std::runtime_error("Max Load Factor must be in range (0.0, 1.0)");
+			}
+			max_load_factor_ = z;
+		}
+
+		///  Rebuilds the table with at least n slots, rounded up to a power
+		///  of two, and never fewer than the elements need.
+		void rehash(size_type n) {
+			size_type needed = static_cast<size_type>(length_ / max_load_factor_) + 1;
+			compact_hash_map other(n > needed ? n : needed);
+			other.max_load_factor_ = max_load_factor_;
+			for (size_type i = 0; i < capacity_; i++) {
+				if (distance(i) != 0) {
+					other.add(mixed_key(i), value(i));
+				}
+			}
+			*this = std::move(other);
+		}
+
+		void reserve(size_type n) {
+			this->rehash(static_cast<size_type>(n / max_load_factor_) + 1);
+		}
+
+	private:
+		static constexpr unsigned distance_bits = 8;
+		static constexpr uint64_t max_distance = (1u << distance_bits) - 1;
+
+		static constexpr uint64_t low_bits(unsigned n) noexcept {
+			return n >= 64 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << n) - 1;
+		}
+
+		void allocate(size_type n) {
+			capacity_ = power_of_two_growth().capacity_for(n);
+			mask_ = capacity_ - 1;
+			quotient_bits_ = 0;
+			while ((static_cast<size_type>(1) << quotient_bits_) < capacity_) {
+				quotient_bits_++;
+			}
+			remainder_bits_ = 64 - quotient_bits_;
+			slot_bits_ = distance_bits + remainder_bits_ + ValueBits;
+			// one spare word, so a field read can always touch two words.
+			words_.assign((capacity_ * slot_bits_ + 63) / 64 + 1, 0);
+			length_ = 0;
+		}
+
+		uint64_t read_bits(size_type offset, unsigned n) const noexcept {
+			size_type w = offset >> 6;
+			unsigned shift = static_cast<unsigned>(offset & 63);
+			uint64_t bits = words_[w] >> shift;
+			if (shift != 0 && shift + n > 64) {
+				bits |= words_[w + 1] << (64 - shift);
+			}
+			return bits & low_bits(n);
+		}
+
+		void write_bits(size_type offset, unsigned n, uint64_t bits) noexcept {
+			size_type w = offset >> 6;
+			unsigned shift = static_cast<unsigned>(offset & 63);
+			uint64_t mask = low_bits(n);
+			bits &= mask;
+			words_[w] = (words_[w] & ~(mask << shift)) | (bits << shift);
+			if (shift != 0 && shift + n > 64) {
+				words_[w + 1] = (words_[w + 1] & ~(mask >> (64 - shift))) | (bits >> (64 - shift));
+			}
+		}
+
+		///  Probe distance plus one; 0 marks an empty slot.
+		uint64_t distance(size_type index) const noexcept {
+			return read_bits(index * slot_bits_, distance_bits);
+		}
+		uint64_t remainder(size_type index) const noexcept {
+			return read_bits(index * slot_bits_ + distance_bits, remainder_bits_);
+		}
+		mapped_type value(size_type index) const noexcept {
+			return static_cast<mapped_type>(read_bits(index * slot_bits_ + distance_bits + remainder_bits_, ValueBits));
+		}
+		void set_value(size_type index, mapped_type v) noexcept {
+			write_bits(index * slot_bits_ + distance_bits + remainder_bits_, ValueBits, v);
+		}
+
+		void write(size_type index, uint64_t d, uint64_t rem, uint64_t v) noexcept {
+			size_type offset = index * slot_bits_;
+			write_bits(offset, distance_bits, d);
+			write_bits(offset + distance_bits, remainder_bits_, rem);
+			write_bits(offset + distance_bits + remainder_bits_, ValueBits, v);
+		}
+
+		///  Rebuilds the mixed key from the slot position and the remainder.
+		uint64_t mixed_key(size_type index) const noexcept {
+			uint64_t home = (index - (distance(index) - 1)) & mask_;
+			return (home << remainder_bits_) | remainder(index);
+		}
+
+		value_type entry_at(size_type index) const {
+			return { detail::unmix64(mixed_key(index)), value(index) };
+		}
+
+		size_type home_of(uint64_t mixed) const noexcept {
+			return static_cast<size_type>(mixed >> remainder_bits_);
+		}
+
+		size_type next_full(size_type index) const noexcept {
+			while (index < capacity_ && distance(index) == 0) {
+				index++;
+			}
+			return index;
+		}
+
+		size_type find_index(const key_type& k) const noexcept {
+			return find_mixed(detail::fmix64(k));
+		}
+
+		size_type find_mixed(uint64_t mixed) const noexcept {
+			uint64_t rem = mixed & low_bits(remainder_bits_);
+			size_type index = home_of(mixed);
+			// an element with a shorter distance than ours means k is absent.
+			for (uint64_t d = 1; d <= max_distance; d++) {
+				uint64_t slot = distance(index);
+				if (slot < d) {
+					return capacity_;
+				}
+				if (slot == d && remainder(index) == rem) {
+					return index;
+				}
+				index = (index + 1) & mask_;
+			}
+			return capacity_;
+		}
+
+		///  Robin Hood insert of a key known to be absent; returns its slot.
+		size_type add(uint64_t mixed, uint64_t v) {
+			if (length_ + 1 > capacity_ * max_load_factor_) {
+				this->rehash(capacity_ * 2);
+			}
+
+			uint64_t rem = mixed & low_bits(remainder_bits_);
+			size_type index = home_of(mixed);
+			size_type placed = capacity_;
+			for (uint64_t d = 1;; d++) {
+				if (d > max_distance) {
+					// the probe distance no longer fits: grow, then place the
+					// element we carry, which is the new one unless it was placed.
+					uint64_t carried = (((index - (d - 1)) & mask_) << remainder_bits_) | rem;
+					if (placed != capacity_) {
+						length_++;
+					}
+					this->rehash(capacity_ * 2);
+					add(carried, v);
+					return find_mixed(mixed);
+				}
+
+				uint64_t slot = distance(index);
+				if (slot == 0) {
+					write(index, d, rem, v);
+					length_++;
+					return placed == capacity_ ? index : placed;
+				}
+				if (slot < d) {
+					// the resident is closer to home: it moves on, we take the slot.
+					uint64_t resident_rem = remainder(index);
+					uint64_t resident_v = value(index);
+					write(index, d, rem, v);
+					if (placed == capacity_) {
+						placed = index;
+					}
+					rem = resident_rem;
+					v = resident_v;
+					d = slot;
+				}
+				index = (index + 1) & mask_;
+			}
+		}
+
+		std::vector<uint64_t> words_;
+		size_type capacity_ = 0;
+		size_type mask_ = 0;
+		size_type length_ = 0;
+		unsigned quotient_bits_ = 0;
+		unsigned remainder_bits_ = 0;
+		unsigned slot_bits_ = 0;
+		float max_load_factor_ = 0.875f;
+	};
+
+}  // namespace fefu
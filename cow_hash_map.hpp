@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	/// Copy-on-write handle to a hash_map. Copies share one table through a
+	/// reference count, so taking a snapshot is O(1) however large the map
+	/// is; the first mutation through a handle whose table is shared clones
+	/// the whole table, and later mutations go to the private copy. A
+	/// snapshot therefore never sees changes made after it was taken.
+	///
+	/// Iterators, pointers and references returned by the modifiers point
+	/// into the writer's table and are invalidated like those of hash_map,
+	/// and also by taking a copy of the handle: after that the next write
+	/// clones again. Lookups only hand out const access.
+	///
+	/// Snapshots may be read, copied and dropped on other threads while the
+	/// writer keeps modifying its own handle: the handle count is released
+	/// by every drop and acquired before a write skips the clone, so the
+	/// readers of a table are done with it before it is modified in place.
+	/// A single handle must not be used by several threads at once without
+	/// synchronization.
+	template <typename K, typename T, typename Hash = std::hash<K>,
+		typename Pred = std::equal_to<K>,
+		typename Alloc = allocator<std::pair<const K, T>>,
+		typename Metadata = byte_metadata,
+		typename Stats = no_stats,
+		typename GrowthPolicy = doubling_growth>
+	class cow_hash_map {
+	public:
+		using map_type = hash_map<K, T, Hash, Pred, Alloc, Metadata, Stats, GrowthPolicy>;
+		using key_type = K;
+		using mapped_type = T;
+		using hasher = Hash;
+		using key_equal = Pred;
+		using value_type = typename map_type::value_type;
+		using reference = typename map_type::reference;
+		using const_reference = typename map_type::const_reference;
+		using iterator = typename map_type::iterator;
+		using const_iterator = typename map_type::const_iterator;
+		using size_type = std::size_t;
+
+		cow_hash_map() : table_(new table()) {}
+
+		explicit cow_hash_map(size_type n) : table_(new table(n)) {}
+
+		cow_hash_map(std::initializer_list<value_type> l, size_type n = 1) : table_(new table(l, n)) {}
+
+		///  Takes ownership of map's table without copying it.
+		explicit cow_hash_map(map_type&& map) : table_(new table(std::move(map))) {}
+
+		///  O(1): shares the table of other. There is no move constructor, so
+		///  a moved-from handle keeps sharing the table and stays usable.
+		cow_hash_map(const cow_hash_map& other) noexcept : table_(other.table_) {
+			table_->handles.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		cow_hash_map& operator=(const cow_hash_map& other) noexcept {
+			other.table_->handles.fetch_add(1, std::memory_order_relaxed);
+			release();
+			table_ = other.table_;
+			return *this;
+		}
+
+		~cow_hash_map() { release(); }
+
+		///  An O(1) copy that shares the current table.
+		cow_hash_map snapshot() const { return *this; }
+
+		///  True while another handle shares the table, i.e. while the next
+		///  modification will clone it.
+		bool shared() const noexcept { return table_->handles.load(std::memory_order_acquire) > 1; }
+
+		///  The table itself, for read-only use of the hash_map interface.
+		const map_type& map() const noexcept { return table_->map; }
+
+		// size and capacity:
+		bool empty() const noexcept { return table_->map.empty(); }
+		size_type size() const noexcept { return table_->map.size(); }
+		size_type bucket_count() const noexcept { return table_->map.bucket_count(); }
+		float load_factor() const noexcept { return table_->map.load_factor(); }
+
+		// iterators.
+		const_iterator begin() const noexcept { return table_->map.cbegin(); }
+		const_iterator end() const noexcept { return table_->map.cend(); }
+		const_iterator cbegin() const noexcept { return table_->map.cbegin(); }
+		const_iterator cend() const noexcept { return table_->map.cend(); }
+
+		// modifiers.
+		template <typename... _Args>
+		std::pair<iterator, bool> emplace(_Args&&... args) {
+			return write().emplace(std::forward<_Args>(args)...);
+		}
+
+		template <typename... _Args>
+		std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
+			return write().try_emplace(k, std::forward<_Args>(args)...);
+		}
+
+		template <typename... _Args>
+		std::pair<iterator, bool> try_emplace(key_type&& k, _Args&&... args) {
+			return write().try_emplace(std::move(k), std::forward<_Args>(args)...);
+		}
+
+		std::pair<iterator, bool> insert(const value_type& x) { return write().insert(x); }
+		std::pair<iterator, bool> insert(value_type&& x) { return write().insert(std::move(x)); }
+
+		template <typename _InputIterator>
+		void insert(_InputIterator first, _InputIterator last) {
+			write().insert(first, last);
+		}
+
+		void insert(std::initializer_list<value_type> l) { write().insert(l); }
+
+		template <typename _Obj>
+		std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
+			return write().insert_or_assign(k, std::forward<_Obj>(obj));
+		}
+
+		template <typename _Obj>
+		std::pair<iterator, bool> insert_or_assign(key_type&& k, _Obj&& obj) {
+			return write().insert_or_assign(std::move(k), std::forward<_Obj>(obj));
+		}
+
+		mapped_type& operator[](const key_type& k) { return write()[k]; }
+		mapped_type& operator[](key_type&& k) { return write()[std::move(k)]; }
+
+		///  Doesn't clone the table when x is absent.
+		size_type erase(const key_type& x) {
+			if (shared() && !table_->map.contains(x)) {
+				return 0;
+			}
+			return write().erase(x);
+		}
+
+		///  A shared table is released rather than cloned and cleared; the
+		///  empty one keeps its hasher and load factors.
+		void clear() {
+			if (shared()) {
+				const map_type& map = table_->map;
+				table* empty = new table(1, map.hash_function(), map.key_eq());
+				empty->map.max_load_factor(map.max_load_factor());
+				empty->map.min_load_factor(map.min_load_factor());
+				empty->map.max_probe_length(map.max_probe_length());
+				release();
+				table_ = empty;
+			} else {
+				table_->map.clear();
+			}
+		}
+
+		void swap(cow_hash_map& x) noexcept { std::swap(table_, x.table_); }
+
+		void rehash(size_type n) { write().rehash(n); }
+		void reserve(size_type n) { write().reserve(n); }
+
+		// lookup.
+		const_iterator find(const key_type& x) const { return static_cast<const map_type&>(table_->map).find(x); }
+		size_type count(const key_type& x) const { return table_->map.count(x); }
+		bool contains(const key_type& x) const { return table_->map.contains(x); }
+		const mapped_type& at(const key_type& k) const { return static_cast<const map_type&>(table_->map).at(k); }
+
+		hasher hash_function() const { return table_->map.hash_function(); }
+		key_equal key_eq() const { return table_->map.key_eq(); }
+
+		friend bool operator==(const cow_hash_map& a, const cow_hash_map& b) {
+			return a.table_ == b.table_ || a.table_->map == b.table_->map;
+		}
+		friend bool operator!=(const cow_hash_map& a, const cow_hash_map& b) {
+			return !(a == b);
+		}
+
+	private:
+		///  The table to modify, cloned first while other handles share it.
+		map_type& write() {
+			if (shared()) {
+				table* copy = new table(table_->map);
+				release();
+				table_ = copy;
+			}
+			return table_->map;
+		}
+
+		///  Drops this handle's count; the last handle deletes the table.
+		void release() noexcept {
+			if (table_->handles.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				delete table_;
+			}
+		}
+
+		///  A table and the number of handles sharing it.
+		struct table {
+			std::atomic<size_type> handles{ 1 };
+			map_type map;
+
+			template <typename... _Args>
+			explicit table(_Args&&... args) : map(std::forward<_Args>(args)...) {}
+		};
+
+		table* table_;
+	};
+
+}  // namespace fefu
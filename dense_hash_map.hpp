@@ -0,0 +1,503 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	/// Forward iterator over the full slots of a dense_hash_map.
+	template <typename Map, typename ValueType>
+	class dense_hash_map_iterator {
+		template <typename K, typename T, typename Hash, typename Pred, typename Alloc>
+		friend class dense_hash_map;
+
+		template <typename, typename>
+		friend class dense_hash_map_iterator;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::remove_const_t<ValueType>;
+		using difference_type = std::ptrdiff_t;
+		using reference = ValueType&;
+		using pointer = ValueType*;
+
+		dense_hash_map_iterator() noexcept = default;
+
+		template <typename _Map, typename _V,
+			typename = std::enable_if_t<std::is_convertible_v<_V*, ValueType*>>>
+		dense_hash_map_iterator(const dense_hash_map_iterator<_Map, _V>& other) noexcept
+			: map_(other.map_), index_(other.index_) {
+		}
+
+		reference operator*() const { return map_->slots_[index_]; }
+		pointer operator->() const { return map_->slots_ + index_; }
+
+		// prefix ++
+		dense_hash_map_iterator& operator++() {
+			index_ = map_->next_full(index_ + 1);
+			return *this;
+		}
+		// postfix ++
+		dense_hash_map_iterator operator++(int) {
+			dense_hash_map_iterator result(*this);
+			++(*this);
+			return result;
+		}
+
+		friend bool operator==(const dense_hash_map_iterator& lhs, const dense_hash_map_iterator& rhs) {
+			return lhs.index_ == rhs.index_;
+		}
+		friend bool operator!=(const dense_hash_map_iterator& lhs, const dense_hash_map_iterator& rhs) {
+			return lhs.index_ != rhs.index_;
+		}
+
+	private:
+		dense_hash_map_iterator(Map* map, std::size_t index) noexcept : map_(map), index_(index) {}
+
+		Map* map_ = nullptr;
+		std::size_t index_ = 0;
+	};
+
+	/// Open-addressing map for integer, enum and pointer keys with no
+	/// control bytes: the user reserves an empty key and a deleted key, and
+	/// every slot holds a constructed element whose key tells its state
+	/// (empty and deleted slots keep a default-constructed value). A probe
+	/// reads a single array, and for 8-byte keys in 16-byte slots an AVX2
+	/// build compares the keys of four slots at once.
+	///
+	/// The reserved keys can't be inserted. Capacities are powers of two and
+	/// the table is rebuilt when elements plus tombstones pass
+	/// max_load_factor() (0.5 by default).
+	template <typename K, typename T, typename Hash = hash<K>,
+		typename Pred = std::equal_to<K>,
+		typename Alloc = allocator<std::pair<const K, T>>>
+	class dense_hash_map {
+		static_assert(std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>,
+			"dense_hash_map needs integer, enum or pointer keys");
+		static_assert(std::is_default_constructible_v<T>,
+			"dense_hash_map keeps a default-constructed value in empty slots");
+
+		template <typename, typename>
+		friend class dense_hash_map_iterator;
+	public:
+		using key_type = K;
+		using mapped_type = T;
+		using hasher = Hash;
+		using key_equal = Pred;
+		using allocator_type = Alloc;
+		using value_type = std::pair<const key_type, mapped_type>;
+		using reference = value_type&;
+		using const_reference = const value_type&;
+		using size_type = std::size_t;
+		using iterator = dense_hash_map_iterator<dense_hash_map, value_type>;
+		using const_iterator = dense_hash_map_iterator<const dense_hash_map, const value_type>;
+
+		///  Throws std::runtime_error when the two reserved keys are equal.
+		dense_hash_map(key_type empty_key, key_type deleted_key, size_type n = 0)
+			: empty_key_(empty_key), deleted_key_(deleted_key) {
+			if (pred_(empty_key_, deleted_key_)) {
+				throw std::runtime_error("Empty and deleted keys must differ");
+			}
+			if (n > 0) {
+				this->rehash(n);
+			}
+		}
+
+		dense_hash_map(const dense_hash_map& other)
+			: hasher_(other.hasher_), allocator_(other.allocator_), pred_(other.pred_),
+			empty_key_(other.empty_key_), deleted_key_(other.deleted_key_),
+			max_load_factor_(other.max_load_factor_) {
+			if (other.capacity_ == 0) {
+				return;
+			}
+
+			value_type* slots = allocator_.allocate(other.capacity_);
+			size_type i = 0;
+			try {
+				for (; i < other.capacity_; i++) {
+					new (slots + i) value_type(other.slots_[i]);
+				}
+			} catch (...) {
+				destroy_slots(slots, i);
+				allocator_.deallocate(slots, other.capacity_);
+				throw;
+			}
+			slots_ = slots;
+			capacity_ = other.capacity_;
+			length_ = other.length_;
+			deleted_ = other.deleted_;
+		}
+
+		dense_hash_map(dense_hash_map&& other) noexcept
+			: hasher_(std::move(other.hasher_)), allocator_(std::move(other.allocator_)), pred_(std::move(other.pred_)),
+			empty_key_(other.empty_key_), deleted_key_(other.deleted_key_),
+			max_load_factor_(other.max_load_factor_),
+			slots_(other.slots_), capacity_(other.capacity_), length_(other.length_), deleted_(other.deleted_) {
+			other.slots_ = nullptr;
+			other.capacity_ = 0;
+			other.length_ = 0;
+			other.deleted_ = 0;
+		}
+
+		~dense_hash_map() {
+			release();
+		}
+
+		dense_hash_map& operator=(const dense_hash_map& other) {
+			if (this != &other) {
+				dense_hash_map copy(other);
+				this->swap(copy);
+			}
+			return *this;
+		}
+
+		dense_hash_map& operator=(dense_hash_map&& other) noexcept {
+			if (this != &other) {
+				dense_hash_map moved(std::move(other));
+				this->swap(moved);
+			}
+			return *this;
+		}
+
+		// size and capacity:
+		bool empty() const noexcept { return length_ == 0; }
+		size_type size() const noexcept { return length_; }
+
+		key_type empty_key() const noexcept { return empty_key_; }
+		key_type deleted_key() const noexcept { return deleted_key_; }
+
+		// iterators.
+		iterator begin() noexcept { return iterator(this, next_full(0)); }
+		iterator end() noexcept { return iterator(this, capacity_); }
+		const_iterator begin() const noexcept { return cbegin(); }
+		const_iterator end() const noexcept { return cend(); }
+		const_iterator cbegin() const noexcept { return const_iterator(this, next_full(0)); }
+		const_iterator cend() const noexcept { return const_iterator(this, capacity_); }
+
+		// modifiers.
+		template <typename... _Args>
+		std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
+			return emplace_key(k, std::piecewise_construct,
+				std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Args>(args)...));
+		}
+
+		std::pair<iterator, bool> insert(const value_type& x) {
+			return emplace_key(x.first, x);
+		}
+
+		std::pair<iterator, bool> insert(value_type&& x) {
+			return emplace_key(x.first, std::move(x));
+		}
+
+		template <typename _InputIterator>
+		void insert(_InputIterator first, _InputIterator last) {
+			for (auto iter = first; iter != last; iter++) {
+				this->insert(*iter);
+			}
+		}
+
+		template <typename _Obj>
+		std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
+			auto result = this->try_emplace(k, std::forward<_Obj>(obj));
+			if (!result.second) {
+				result.first->second = std::forward<_Obj>(obj);
+			}
+			return result;
+		}
+
+		mapped_type& operator[](const key_type& k) {
+			size_type index = this->try_emplace(k).first.index_;
+			return slots_[index].second;
+		}
+
+		iterator erase(const_iterator position) {
+			if (position.index_ >= capacity_ || !is_full(position.index_)) {
+				throw std::runtime_error("Invalid iterator for erase data");
+			}
+			erase_slot(position.index_);
+			return iterator(this, next_full(position.index_ + 1));
+		}
+
+		size_type erase(const key_type& x) {
+			size_type index = find_index(x);
+			if (index == capacity_) {
+				return 0;
+			}
+			erase_slot(index);
+			return 1;
+		}
+
+		///  Resets every slot to the empty key; the capacity is kept.
+		void clear() {
+			for (size_type i = 0; i < capacity_; i++) {
+				if (!pred_(slots_[i].first, empty_key_)) {
+					reset_slot(i, empty_key_);
+				}
+			}
+			length_ = 0;
+			deleted_ = 0;
+		}
+
+		void swap(dense_hash_map& x) noexcept {
+			std::swap(hasher_, x.hasher_);
+			std::swap(allocator_, x.allocator_);
+			std::swap(pred_, x.pred_);
+			std::swap(empty_key_, x.empty_key_);
+			std::swap(deleted_key_, x.deleted_key_);
+			std::swap(max_load_factor_, x.max_load_factor_);
+			std::swap(slots_, x.slots_);
+			std::swap(capacity_, x.capacity_);
+			std::swap(length_, x.length_);
+			std::swap(deleted_, x.deleted_);
+		}
+
+		// lookup.
+		iterator find(const key_type& x) { return iterator(this, find_index(x)); }
+		const_iterator find(const key_type& x) const { return const_iterator(this, find_index(x)); }
+
+		size_type count(const key_type& x) const {
+			return (find_index(x) != capacity_ ? 1 : 0);
+		}
+
+		bool contains(const key_type& x) const {
+			return (this->count(x) == 1);
+		}
+
+		mapped_type& at(const key_type& k) {
+			size_type index = find_index(k);
+			if (index == capacity_) {
+				throw std::out_of_range("Out of range");
+			}
+			return slots_[index].second;
+		}
+		const mapped_type& at(const key_type& k) const {
+			size_type index = find_index(k);
+			if (index == capacity_) {
+				throw std::out_of_range("Out of range");
+			}
+			return slots_[index].second;
+		}
+
+		// bucket interface.
+		size_type bucket_count() const noexcept { return capacity_; }
+
+		// hash policy.
+		float load_factor() const noexcept {
+			return capacity_ == 0 ? 0.0f : static_cast<float>(length_) / capacity_;
+		}
+		float max_load_factor() const noexcept { return max_load_factor_; }
+		void max_load_factor(float z) {
+			if (z >= 1.0 || z <= 0.0) {
+				throw std::runtime_error("Max Load Factor must be in range (0.0, 1.0)");
+			}
+			max_load_factor_ = z;
+		}
+
+		///  Rebuilds the table with room for at least n slots, dropping the
+		///  tombstones; the size is rounded up to a power of two.
+		void rehash(size_type n) {
+			size_type needed = static_cast<size_type>(length_ / max_load_factor_) + 1;
+			size_type capacity = power_of_two_growth().capacity_for(n > needed ? n : needed);
+
+			value_type* slots = allocator_.allocate(capacity);
+			size_type i = 0;
+			try {
+				for (; i < capacity; i++) {
+					new (slots + i) value_type(std::piecewise_construct, std::forward_as_tuple(empty_key_), std::tuple<>());
+				}
+			} catch (...) {
+				destroy_slots(slots, i);
+				allocator_.deallocate(slots, capacity);
+				throw;
+			}
+
+			for (size_type j = 0; j < capacity_; j++) {
+				if (is_full(j)) {
+					size_type index = home(slots_[j].first, capacity);
+					while (!pred_(slots[index].first, empty_key_)) {
+						index = (index + 1) & (capacity - 1);
+					}
+					slots[index].~value_type();
+					new (slots + index) value_type(std::move(slots_[j]));
+				}
+			}
+
+			release();
+			slots_ = slots;
+			capacity_ = capacity;
+			deleted_ = 0;
+		}
+
+		void reserve(size_type n) {
+			this->rehash(static_cast<size_type>(n / max_load_factor_) + 1);
+		}
+
+	private:
+		bool is_full(size_type index) const {
+			const key_type& key = slots_[index].first;
+			return !pred_(key, empty_key_) && !pred_(key, deleted_key_);
+		}
+
+		size_type home(const key_type& k, size_type capacity) const {
+			return power_of_two_growth().template index<is_avalanching_v<Hash>>(hasher_(k), capacity);
+		}
+
+		size_type next_full(size_type index) const {
+			while (index < capacity_ && !is_full(index)) {
+				index++;
+			}
+			return index;
+		}
+
+		///  Returns the slot holding x, or capacity_ when it is absent.
+		size_type find_index(const key_type& x) const {
+			if (capacity_ == 0 || pred_(x, empty_key_) || pred_(x, deleted_key_)) {
+				return capacity_;
+			}
+
+			size_type index = home(x, capacity_);
+#if defined(FEFU_HAS_AVX2)
+			if constexpr (detail::is_scannable_key<K, Pred>::value && sizeof(key_type) == 8 && sizeof(value_type) == 16) {
+				// keys sit in 64-bit lanes 0 and 2 of each 32-byte load.
+				const __m256i match = _mm256_set1_epi64x(static_cast<long long>(key_bits(x)));
+				const __m256i stop = _mm256_set1_epi64x(static_cast<long long>(key_bits(empty_key_)));
+				while (index + 4 <= capacity_) {
+					const char* p = reinterpret_cast<const char*>(slots_ + index);
+					__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+					__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+					uint32_t hits = static_cast<uint32_t>(
+						_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, match))) |
+						(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, match))) << 4)) & 0x55;
+					uint32_t ends = static_cast<uint32_t>(
+						_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, stop))) |
+						(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, stop))) << 4)) & 0x55;
+					if ((hits | ends) != 0) {
+						unsigned first = detail::count_trailing_zeros(hits | ends);
+						return ((hits >> first) & 1) != 0 ? index + first / 2 : capacity_;
+					}
+					index += 4;
+				}
+				index &= capacity_ - 1;
+			}
+#endif
+			for (size_type probes = 0; probes < capacity_; probes++) {
+				const key_type& key = slots_[index].first;
+				if (pred_(key, x)) {
+					return index;
+				}
+				if (pred_(key, empty_key_)) {
+					return capacity_;
+				}
+				index = (index + 1) & (capacity_ - 1);
+			}
+			return capacity_;
+		}
+
+		static uint64_t key_bits(const key_type& k) noexcept {
+			uint64_t bits = 0;
+			std::memcpy(&bits, &k, sizeof(k));
+			return bits;
+		}
+
+		///  Finds key or the slot to put it in, growing first when the new
+		///  element and the tombstones would pass max_load_factor().
+		size_type prepare_insert(const key_type& key) {
+			if (pred_(key, empty_key_) || pred_(key, deleted_key_)) {
+				throw std::runtime_error("Key is reserved as the empty or deleted key");
+			}
+			if (length_ + deleted_ + 1 > capacity_ * max_load_factor_) {
+				// mostly tombstones: rebuilding at the same size is enough.
+				size_type n = (length_ + 1 > capacity_ * max_load_factor_ / 2 ? capacity_ * 2 : capacity_);
+				this->rehash(n < 8 ? 8 : n);
+			}
+
+			size_type probes = 0;
+			return detail::linear_probe(home(key, capacity_), capacity_,
+				[this](size_type i) {
+					const key_type& k = slots_[i].first;
+					return pred_(k, empty_key_) ? detail::slot_empty : pred_(k, deleted_key_) ? detail::slot_deleted : detail::slot_full;
+				},
+				[this, &key](size_type i) { return pred_(slots_[i].first, key); }, probes);
+		}
+
+		template <typename... _Args>
+		std::pair<iterator, bool> emplace_key(const key_type& key, _Args&&... args) {
+			size_type index = prepare_insert(key);
+			key_type previous = slots_[index].first;
+			if (!pred_(previous, empty_key_) && !pred_(previous, deleted_key_)) {
+				return { iterator(this, index), false };
+			}
+
+			slots_[index].~value_type();
+			try {
+				new (slots_ + index) value_type(std::forward<_Args>(args)...);
+			} catch (...) {
+				new (slots_ + index) value_type(std::piecewise_construct, std::forward_as_tuple(previous), std::tuple<>());
+				throw;
+			}
+			if (pred_(previous, deleted_key_)) {
+				deleted_--;
+			}
+			length_++;
+			return { iterator(this, index), true };
+		}
+
+		void reset_slot(size_type index, const key_type& key) {
+			slots_[index].~value_type();
+			new (slots_ + index) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>());
+		}
+
+		///  Leaves a tombstone, unless the next slot is empty: then no probe
+		///  can pass this slot, and the tombstones right before it can go too.
+		void erase_slot(size_type index) {
+			length_--;
+			size_type mask = capacity_ - 1;
+			if (!pred_(slots_[(index + 1) & mask].first, empty_key_)) {
+				reset_slot(index, deleted_key_);
+				deleted_++;
+				return;
+			}
+
+			reset_slot(index, empty_key_);
+			for (index = (index - 1) & mask; pred_(slots_[index].first, deleted_key_); index = (index - 1) & mask) {
+				reset_slot(index, empty_key_);
+				deleted_--;
+			}
+		}
+
+		void destroy_slots(value_type* slots, size_type n) noexcept {
+			for (size_type i = 0; i < n; i++) {
+				slots[i].~value_type();
+			}
+		}
+
+		void release() noexcept {
+			if (slots_ != nullptr) {
+				destroy_slots(slots_, capacity_);
+				allocator_.deallocate(slots_, capacity_);
+				slots_ = nullptr;
+			}
+		}
+
+		hasher hasher_;
+		allocator_type allocator_;
+		key_equal pred_;
+		key_type empty_key_;
+		key_type deleted_key_;
+		float max_load_factor_ = 0.5f;
+
+		value_type* slots_ = nullptr;
+		size_type capacity_ = 0;
+		size_type length_ = 0;
+		size_type deleted_ = 0;
+	};
+
+}  // namespace fefu
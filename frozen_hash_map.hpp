@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "hash.hpp"
+
+namespace fefu {
+
+	/// Immutable map built by hash_map::freeze(). The elements are packed
+	/// back to back, grouped by home bucket, and an offset array gives the
+	/// first element of every bucket, so there are no empty slots and no
+	/// tombstones. With one bucket per element a lookup compares about 1.5
+	/// keys on a hit, and the layout costs sizeof(value_type) plus 4 bytes
+	/// per element. Every member is const, so any number of threads can
+	/// read a frozen map without synchronization.
+	template <typename K, typename T, typename Hash = std::hash<K>,
+		typename Pred = std::equal_to<K>>
+	class frozen_hash_map {
+	public:
+		using key_type = K;
+		using mapped_type = T;
+		using hasher = Hash;
+		using key_equal = Pred;
+		using value_type = std::pair<const key_type, mapped_type>;
+		using reference = const value_type&;
+		using const_reference = const value_type&;
+		using size_type = std::size_t;
+		using const_iterator = typename std::vector<value_type>::const_iterator;
+		using iterator = const_iterator;
+
+		frozen_hash_map() : offsets_(2, 0) {}
+
+		///  Packs the n elements of [first, last), which must have distinct
+		///  keys. hash must be the hasher the keys were hashed with before,
+		///  so seeded hashers keep their seed.
+		template <typename _InputIterator>
+		frozen_hash_map(_InputIterator first, _InputIterator last, size_type n,
+			const hasher& hash = hasher(), const key_equal& pred = key_equal())
+			: hasher_(hash), pred_(pred), bucket_count_(n == 0 ? 1 : n) {
+			if (n >= std::numeric_limits<uint32_t>::max()) {
+				throw std::runtime_error("Too many elements for frozen_hash_map");
+			}
+
+			// counting sort by home bucket, the elements are only visited twice.
+			std::vector<const value_type*> sources;
+			std::vector<uint32_t> buckets;
+			sources.reserve(n);
+			buckets.reserve(n);
+			offsets_.assign(bucket_count_ + 1, 0);
+			for (auto iter = first; iter != last; ++iter) {
+				uint32_t b = static_cast<uint32_t>(bucket_of((*iter).first));
+				sources.push_back(&*iter);
+				buckets.push_back(b);
+				offsets_[b + 1]++;
+			}
+			for (size_type b = 0; b < bucket_count_; b++) {
+				offsets_[b + 1] += offsets_[b];
+			}
+
+			std::vector<uint32_t> order(sources.size());
+			std::vector<uint32_t> fill(offsets_.begin(), offsets_.end() - 1);
+			for (size_type i = 0; i < sources.size(); i++) {
+				order[fill[buckets[i]]++] = static_cast<uint32_t>(i);
+			}
+
+			entries_.reserve(sources.size());
+			for (uint32_t i : order) {
+				entries_.push_back(*sources[i]);
+			}
+		}
+
+		// size and capacity:
+		bool empty() const noexcept { return entries_.empty(); }
+		size_type size() const noexcept { return entries_.size(); }
+		size_type bucket_count() const noexcept { return bucket_count_; }
+
+		///  Bytes held by the entries and the bucket offsets.
+		size_type memory_usage() const noexcept {
+			return entries_.capacity() * sizeof(value_type) + offsets_.capacity() * sizeof(uint32_t);
+		}
+
+		// iterators.
+		const_iterator begin() const noexcept { return entries_.begin(); }
+		const_iterator end() const noexcept { return entries_.end(); }
+		const_iterator cbegin() const noexcept { return entries_.cbegin(); }
+		const_iterator cend() const noexcept { return entries_.cend(); }
+
+		// lookup.
+		const_iterator find(const key_type& x) const {
+			size_type b = bucket_of(x);
+			for (size_type i = offsets_[b]; i < offsets_[b + 1]; i++) {
+				if (pred_(entries_[i].first, x)) {
+					return entries_.begin() + static_cast<std::ptrdiff_t>(i);
+				}
+			}
+			return entries_.end();
+		}
+
+		size_type count(const key_type& x) const {
+			return (this->find(x) != this->end() ? 1 : 0);
+		}
+
+		bool contains(const key_type& x) const {
+			return (this->count(x) == 1);
+		}
+
+		const mapped_type& at(const key_type& k) const {
+			auto iter = this->find(k);
+			if (iter == this->end()) {
+				throw std::out_of_range("Out of range");
+			}
+			return iter->second;
+		}
+
+		hasher hash_function() const { return hasher_; }
+		key_equal key_eq() const { return pred_; }
+
+	private:
+		///  Maps the hash to [0, bucket_count_) with a multiply; weak hashers
+		///  are mixed first, since the multiply keeps only the high bits.
+		size_type bucket_of(const key_type& k) const {
+			uint64_t hash = static_cast<uint64_t>(hasher_(k));
+			if constexpr (!is_avalanching_v<Hash>) {
+				hash = detail::mix64(hash);
+			}
+			uint64_t lo, hi;
+			detail::multiply128(hash, bucket_count_, lo, hi);
+			return static_cast<size_type>(hi);
+		}
+
+		hasher hasher_;
+		key_equal pred_;
+		size_type bucket_count_ = 1;
+		std::vector<uint32_t> offsets_;
+		std::vector<value_type> entries_;
+	};
+
+}  // namespace fefu
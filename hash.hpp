@@ -0,0 +1,286 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace fefu {
+
+	/// True when Hash already spreads every input bit over the whole result,
+	/// so hash_map can use it without mixing it again. A hasher opts in with
+	/// a nested `using is_avalanching = void;`.
+	template <typename Hash, typename = void>
+	struct is_avalanching : std::false_type {};
+
+	template <typename Hash>
+	struct is_avalanching<Hash, std::void_t<typename Hash::is_avalanching>> : std::true_type {};
+
+	template <typename Hash>
+	inline constexpr bool is_avalanching_v = is_avalanching<Hash>::value;
+
+	/// True when Hash can switch to a new seed through reseed(uint64_t);
+	/// hash_map then reseeds it when probe sequences grow suspiciously long.
+	template <typename Hash, typename = void>
+	struct is_reseedable : std::false_type {};
+
+	template <typename Hash>
+	struct is_reseedable<Hash, std::void_t<decltype(std::declval<Hash&>().reseed(uint64_t()))>> : std::true_type {};
+
+	template <typename Hash>
+	inline constexpr bool is_reseedable_v = is_reseedable<Hash>::value;
+
+	namespace detail {
+
+		constexpr uint64_t secret0 = 0xa0761d6478bd642full;
+		constexpr uint64_t secret1 = 0xe7037ed1a0b428dbull;
+		constexpr uint64_t secret2 = 0x8ebc6af09c88c6e3ull;
+		constexpr uint64_t secret3 = 0x589965cc75374cc3ull;
+
+		/// Full 64x64 -> 128 bit product, returned as (low, high).
+		constexpr void multiply128(uint64_t a, uint64_t b, uint64_t& lo, uint64_t& hi) noexcept {
+#if defined(__SIZEOF_INT128__)
+			__uint128_t r = static_cast<__uint128_t>(a) * b;
+			lo = static_cast<uint64_t>(r);
+			hi = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			lo = _umul128(a, b, &hi);
+#else
+			uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+			uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+			uint64_t t = rl + (rm0 << 32);
+			uint64_t c = t < rl;
+			lo = t + (rm1 << 32);
+			c += lo < t;
+			hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+		}
+
+		/// Multiplies and folds the two halves of the product together.
+		constexpr uint64_t wymix(uint64_t a, uint64_t b) noexcept {
+			uint64_t lo = 0, hi = 0;
+			multiply128(a, b, lo, hi);
+			return lo ^ hi;
+		}
+
+		/// Multiply-xorshift finalizer; every input bit affects every output bit.
+		constexpr uint64_t mix64(uint64_t x) noexcept {
+			return wymix(x, 0x9E3779B97F4A7C15ull);
+		}
+
+		inline uint64_t read64(const unsigned char* p) noexcept {
+			uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		inline uint64_t read32(const unsigned char* p) noexcept {
+			uint32_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		/// Returns a new unpredictable seed. One random_device read per process,
+		/// then a counter and the clock mixed through wymix.
+		inline uint64_t random_seed() noexcept {
+			static const uint64_t process_seed = [] {
+				std::random_device rd;
+				return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+			}();
+			static std::atomic<uint64_t> counter{ 0 };
+
+			uint64_t n = counter.fetch_add(1, std::memory_order_relaxed);
+			uint64_t t = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+			return wymix(process_seed ^ secret2 ^ t, n ^ secret3);
+		}
+
+		/// wyhash-style byte hash: 48-byte stripes folded through wymix.
+		inline uint64_t hash_bytes(const void* key, std::size_t len, uint64_t seed) noexcept {
+			const unsigned char* p = static_cast<const unsigned char*>(key);
+			seed ^= wymix(seed ^ secret0, secret1);
+
+			uint64_t a, b;
+			if (len <= 16) {
+				if (len >= 4) {
+					a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+					b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+				} else if (len > 0) {
+					a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+					b = 0;
+				} else {
+					a = b = 0;
+				}
+			} else {
+				std::size_t i = len;
+				if (i > 48) {
+					uint64_t see1 = seed, see2 = seed;
+					do {
+						seed = wymix(read64(p) ^ secret1, read64(p + 8) ^ seed);
+						see1 = wymix(read64(p + 16) ^ secret2, read64(p + 24) ^ see1);
+						see2 = wymix(read64(p + 32) ^ secret3, read64(p + 40) ^ see2);
+						p += 48;
+						i -= 48;
+					} while (i > 48);
+					seed ^= see1 ^ see2;
+				}
+				while (i > 16) {
+					seed = wymix(read64(p) ^ secret1, read64(p + 8) ^ seed);
+					i -= 16;
+					p += 16;
+				}
+				a = read64(p + i - 16);
+				b = read64(p + i - 8);
+			}
+
+			multiply128(a ^ secret1, b ^ seed, a, b);
+			return wymix(a ^ secret0 ^ len, b ^ secret1);
+		}
+
+	}  // namespace detail
+
+	/// Fast, avalanching hash. Integers go through a multiply-xorshift,
+	/// strings through a wyhash-class byte hash.
+	template <typename K, typename = void>
+	struct hash;
+
+	template <typename K>
+	struct hash<K, std::enable_if_t<std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>>> {
+		using is_avalanching = void;
+
+		constexpr std::size_t operator()(K k) const noexcept {
+			uint64_t x = 0;
+			if constexpr (std::is_pointer_v<K>) {
+				x = static_cast<uint64_t>(reinterpret_cast<std::uintptr_t>(k));
+			} else {
+				x = static_cast<uint64_t>(k);
+			}
+			return static_cast<std::size_t>(detail::mix64(x));
+		}
+	};
+
+	/// String hash usable for std::string, std::string_view and C strings,
+	/// so a map with std::equal_to<> can be probed without building a string.
+	struct string_hash {
+		using is_avalanching = void;
+		using is_transparent = void;
+
+		std::size_t operator()(std::string_view s) const noexcept {
+			return static_cast<std::size_t>(detail::hash_bytes(s.data(), s.size(), 0));
+		}
+		std::size_t operator()(const std::string& s) const noexcept {
+			return (*this)(std::string_view(s));
+		}
+		std::size_t operator()(const char* s) const noexcept {
+			return (*this)(std::string_view(s));
+		}
+	};
+
+	template <>
+	struct hash<std::string> : string_hash {};
+
+	template <>
+	struct hash<std::string_view> : string_hash {};
+
+	template <typename A, typename B>
+	struct hash<std::pair<A, B>> {
+		using is_avalanching = void;
+
+		std::size_t operator()(const std::pair<A, B>& p) const noexcept {
+			uint64_t h = detail::mix64(detail::secret0 ^ hash<A>()(p.first));
+			return static_cast<std::size_t>(detail::mix64(h ^ hash<B>()(p.second)));
+		}
+	};
+
+	template <typename... Ts>
+	struct hash<std::tuple<Ts...>> {
+		using is_avalanching = void;
+
+		std::size_t operator()(const std::tuple<Ts...>& t) const noexcept {
+			return combine(t, std::index_sequence_for<Ts...>());
+		}
+
+	private:
+		template <std::size_t... Is>
+		static std::size_t combine(const std::tuple<Ts...>& t, std::index_sequence<Is...>) noexcept {
+			uint64_t h = detail::secret0;
+			((h = detail::mix64(h ^ hash<std::decay_t<Ts>>()(std::get<Is>(t)))), ...);
+			return static_cast<std::size_t>(h);
+		}
+	};
+
+	/// Per-instance random seed shared by the seeded hashers. Two hashers
+	/// compare equal when they produce the same hashes.
+	class hash_seed {
+	public:
+		hash_seed() noexcept : seed_(detail::random_seed()) {}
+		explicit hash_seed(uint64_t seed) noexcept : seed_(seed) {}
+
+		uint64_t seed() const noexcept { return seed_; }
+		void reseed(uint64_t seed) noexcept { seed_ = seed; }
+
+		friend bool operator==(const hash_seed& lhs, const hash_seed& rhs) noexcept {
+			return lhs.seed_ == rhs.seed_;
+		}
+		friend bool operator!=(const hash_seed& lhs, const hash_seed& rhs) noexcept {
+			return lhs.seed_ != rhs.seed_;
+		}
+
+	protected:
+		uint64_t seed_;
+	};
+
+	/// Hash keyed by a per-instance random seed, so the bucket of a key can't
+	/// be predicted from outside. Every default-constructed hasher (and so every
+	/// hash_map using it) gets a fresh seed.
+	template <typename K>
+	struct seeded_hash : hash_seed {
+		using is_avalanching = void;
+
+		using hash_seed::hash_seed;
+
+		std::size_t operator()(const K& k) const noexcept {
+			return static_cast<std::size_t>(detail::mix64(hash<K>()(k) ^ seed_));
+		}
+	};
+
+	/// Seeded string hash: the seed goes into the byte hash itself, so
+	/// crafted full-hash collisions don't survive a reseed.
+	struct seeded_string_hash : hash_seed {
+		using is_avalanching = void;
+		using is_transparent = void;
+
+		using hash_seed::hash_seed;
+
+		std::size_t operator()(std::string_view s) const noexcept {
+			return static_cast<std::size_t>(detail::hash_bytes(s.data(), s.size(), seed_));
+		}
+		std::size_t operator()(const std::string& s) const noexcept {
+			return (*this)(std::string_view(s));
+		}
+		std::size_t operator()(const char* s) const noexcept {
+			return (*this)(std::string_view(s));
+		}
+	};
+
+	template <>
+	struct seeded_hash<std::string> : seeded_string_hash {
+		using seeded_string_hash::seeded_string_hash;
+	};
+
+	template <>
+	struct seeded_hash<std::string_view> : seeded_string_hash {
+		using seeded_string_hash::seeded_string_hash;
+	};
+
+}  // namespace fefu
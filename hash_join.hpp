@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	/// Tuning of hash_join(); zeros pick the defaults.
+	struct hash_join_options {
+		std::size_t threads = 0;      // std::thread::hardware_concurrency()
+		unsigned radix_bits = 0;      // enough partitions for cache_bytes of build map each
+		std::size_t cache_bytes = 256 * 1024;
+	};
+
+	namespace detail {
+
+		/// A partitioned row of one join input: the index of the row and the
+		/// hash of its key.
+		template <typename Row, typename = void>
+		struct join_tuple {
+			static constexpr bool keeps_hash = true;
+
+			uint64_t hash;
+			std::size_t index;
+
+			join_tuple() = default;
+			join_tuple(uint64_t h, const std::vector<Row>&, std::size_t i) : hash(h), index(i) {}
+
+			const Row& row(const std::vector<Row>& rows) const { return rows[index]; }
+
+			template <typename Hash>
+			uint64_t hash_with(const Hash&) const { return hash; }
+		};
+
+		/// Rows of up to 16 bytes are copied whole, so a partition is read
+		/// sequentially; their small keys are cheaper to hash again than the
+		/// hash is to store.
+		template <typename Row>
+		struct join_tuple<Row, std::enable_if_t<sizeof(Row) <= 16 && std::is_default_constructible_v<Row> &&
+			std::is_trivially_copy_constructible_v<Row> && std::is_trivially_destructible_v<Row>>> {
+			static constexpr bool keeps_hash = false;
+
+			Row copy;
+
+			join_tuple() = default;
+			join_tuple(uint64_t, const std::vector<Row>& rows, std::size_t i) : copy(rows[i]) {}
+
+			const Row& row(const std::vector<Row>&) const { return copy; }
+
+			template <typename Hash>
+			uint64_t hash_with(const Hash& hf) const { return static_cast<uint64_t>(hf(copy.first)); }
+		};
+
+		constexpr std::size_t join_no_row = ~static_cast<std::size_t>(0);
+		constexpr std::size_t join_buffer_tuples = 8;
+		constexpr std::size_t join_prefetch_distance = 8;
+
+		/// Runs work(worker) for every worker in [0, threads), the calling
+		/// thread taking worker 0, and rethrows the first exception thrown.
+		/// Workers whose thread can't be started run on the calling thread.
+		template <typename Work>
+		void run_workers(std::size_t threads, Work& work) {
+			std::vector<std::exception_ptr> errors(threads);
+			auto guarded = [&work, &errors](std::size_t worker) {
+				try {
+					work(worker);
+				} catch (...) {
+					errors[worker] = std::current_exception();
+				}
+			};
+
+			std::vector<std::thread> pool;
+			pool.reserve(threads);
+			std::size_t started = 1;
+			try {
+				for (; started < threads; started++) {
+					pool.emplace_back(guarded, started);
+				}
+			} catch (const std::system_error&) {
+			}
+			guarded(0);
+			for (std::size_t worker = started; worker < threads; worker++) {
+				guarded(worker);
+			}
+			for (std::thread& t : pool) {
+				t.join();
+			}
+			for (std::exception_ptr& error : errors) {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+		}
+
+		/// Parallel radix partition of input by the top bits of the hash of
+		/// each key. Every worker hashes and counts its chunk, then scatters it
+		/// through small per-partition buffers that are flushed a whole block
+		/// at a time, which keeps the writes sequential per partition and
+		/// lets them compile to vector copies. Partition p ends up in
+		/// out[bounds[p], bounds[p + 1]).
+		template <typename Row, typename Hash>
+		void radix_partition(const std::vector<Row>& input, const Hash& hf, unsigned bits, std::size_t threads,
+			std::vector<join_tuple<Row>>& out, std::vector<std::size_t>& bounds) {
+			const std::size_t n = input.size();
+			const std::size_t partitions = static_cast<std::size_t>(1) << bits;
+			auto partition_of = [bits](uint64_t hash) -> std::size_t {
+				if constexpr (!is_avalanching_v<Hash>) {
+					hash = mix64(hash);
+				}
+				return bits == 0 ? 0 : static_cast<std::size_t>(hash >> (64 - bits));
+			};
+
+			// kept between the passes only for the keys that are costly to hash.
+			std::vector<uint64_t> hashes(join_tuple<Row>::keeps_hash ? n : 0);
+			auto hash_of = [&](std::size_t i) -> uint64_t {
+				if constexpr (join_tuple<Row>::keeps_hash) {
+					return hashes[i];
+				} else {
+					return static_cast<uint64_t>(hf(input[i].first));
+				}
+			};
+
+			std::vector<std::size_t> offsets(threads * partitions, 0);
+			auto count = [&](std::size_t worker) {
+				std::size_t* histogram = offsets.data() + worker * partitions;
+				for (std::size_t i = n * worker / threads; i < n * (worker + 1) / threads; i++) {
+					if constexpr (join_tuple<Row>::keeps_hash) {
+						hashes[i] = static_cast<uint64_t>(hf(input[i].first));
+					}
+					histogram[partition_of(hash_of(i))]++;
+				}
+			};
+			run_workers(threads, count);
+
+			// partition-major prefix sum: worker w writes partition p after
+			// workers 0..w-1.
+			bounds.assign(partitions + 1, 0);
+			std::size_t running = 0;
+			for (std::size_t p = 0; p < partitions; p++) {
+				bounds[p] = running;
+				for (std::size_t w = 0; w < threads; w++) {
+					std::size_t c = offsets[w * partitions + p];
+					offsets[w * partitions + p] = running;
+					running += c;
+				}
+			}
+			bounds[partitions] = running;
+
+			out.resize(n);
+			auto scatter = [&](std::size_t worker) {
+				std::size_t* next = offsets.data() + worker * partitions;
+				std::vector<join_tuple<Row>> buffers(partitions * join_buffer_tuples);
+				std::vector<unsigned char> fill(partitions, 0);
+				for (std::size_t i = n * worker / threads; i < n * (worker + 1) / threads; i++) {
+					uint64_t hash = hash_of(i);
+					std::size_t p = partition_of(hash);
+					join_tuple<Row>* buffer = buffers.data() + p * join_buffer_tuples;
+					buffer[fill[p]++] = join_tuple<Row>(hash, input, i);
+					if (fill[p] == join_buffer_tuples) {
+						std::copy_n(buffer, join_buffer_tuples, out.data() + next[p]);
+						next[p] += join_buffer_tuples;
+						fill[p] = 0;
+					}
+				}
+				for (std::size_t p = 0; p < partitions; p++) {
+					std::copy_n(buffers.data() + p * join_buffer_tuples, fill[p], out.data() + next[p]);
+				}
+			};
+			run_workers(threads, scatter);
+		}
+
+	}  // namespace detail
+
+	/// Parallel equi-join of two vectors of (key, payload) pairs. Both sides
+	/// are radix-partitioned by key hash so that each partition's build side
+	/// fits a cache-sized hash_map; the workers then take partitions one at a
+	/// time, build the map and probe it with prefetched lookups. The maps
+	/// share hf, so the partitioning hashes are reused for the lookups until
+	/// a map's probe-length guard reseeds its copy of hf. Rows of up to 16
+	/// bytes are copied into the partitions, larger ones are read from the
+	/// inputs.
+	///
+	/// emit(worker, key, build_payload, probe_payload) is called for every
+	/// matching pair, concurrently from the worker threads. worker is below
+	/// options.threads (hardware_concurrency() by default), so per-worker
+	/// state needs no locking. Build keys may repeat; each probe row is
+	/// matched with every build row of its key.
+	template <typename K, typename B, typename P, typename Emit, typename Hash = hash<K>,
+		typename Pred = std::equal_to<K>>
+	void hash_join(const std::vector<std::pair<K, B>>& build, const std::vector<std::pair<K, P>>& probe,
+		Emit&& emit, hash_join_options options = hash_join_options(),
+		const Hash& hf = Hash(), const Pred& eql = Pred()) {
+		// power-of-two tables mask the hash instead of dividing it.
+		using map_type = hash_map<K, std::size_t, Hash, Pred, allocator<std::pair<const K, std::size_t>>,
+			byte_metadata, no_stats, power_of_two_growth>;
+		if (build.empty() || probe.empty()) {
+			return;
+		}
+
+		std::size_t threads = options.threads;
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		// below ~64K rows per thread, starting the threads costs more than they save.
+		threads = std::min(threads, 1 + (build.size() + probe.size()) / 65536);
+
+		unsigned bits = options.radix_bits;
+		if (bits == 0) {
+			// a hash_map at its default load takes a bit over twice its slots.
+			std::size_t map_bytes = build.size() * (sizeof(typename map_type::value_type) + 1) * 9 / 4;
+			std::size_t wanted = std::max(threads, map_bytes / std::max<std::size_t>(1, options.cache_bytes));
+			while (bits < 16 && (static_cast<std::size_t>(1) << bits) < wanted) {
+				bits++;
+			}
+		}
+
+		std::vector<detail::join_tuple<std::pair<K, B>>> build_rows;
+		std::vector<detail::join_tuple<std::pair<K, P>>> probe_rows;
+		std::vector<std::size_t> build_bounds, probe_bounds;
+		detail::radix_partition(build, hf, bits, threads, build_rows, build_bounds);
+		detail::radix_partition(probe, hf, bits, threads, probe_rows, probe_bounds);
+
+		// build rows of one key are chained through next, newest first; both
+		// index build_rows.
+		std::vector<std::size_t> next(build.size());
+		const std::size_t partitions = static_cast<std::size_t>(1) << bits;
+		std::atomic<std::size_t> claimed{ 0 };
+		auto join = [&](std::size_t worker) {
+			// one map per worker, cleared between partitions of similar size.
+			map_type map(1, hf, eql);
+			for (std::size_t p = claimed++; p < partitions; p = claimed++) {
+				map.clear();
+				map.reserve(build_bounds[p + 1] - build_bounds[p]);
+				for (std::size_t i = build_bounds[p]; i < build_bounds[p + 1]; i++) {
+					const std::pair<K, B>& row = build_rows[i].row(build);
+					// once the map has reseeded, the partitioning hashes are stale.
+					size_t hash = map.reseed_count() == 0 ? static_cast<size_t>(build_rows[i].hash_with(hf)) : map.hash_of(row.first);
+					auto result = map.try_emplace_hashed(row.first, hash, i);
+					next[i] = (result.second ? detail::join_no_row : result.first->second);
+					result.first->second = i;
+				}
+
+				const bool hashed = map.reseed_count() == 0;
+				for (std::size_t i = probe_bounds[p]; i < probe_bounds[p + 1]; i++) {
+					if (hashed && i + detail::join_prefetch_distance < probe_bounds[p + 1]) {
+						map.prefetch(static_cast<size_t>(probe_rows[i + detail::join_prefetch_distance].hash_with(hf)));
+					}
+					const std::pair<K, P>& row = probe_rows[i].row(probe);
+					auto iter = hashed ? map.find_hashed(row.first, static_cast<size_t>(probe_rows[i].hash_with(hf))) : map.find(row.first);
+					if (iter == map.end()) {
+						continue;
+					}
+					for (std::size_t b = iter->second; b != detail::join_no_row; b = next[b]) {
+						emit(worker, row.first, build_rows[b].row(build).second, row.second);
+					}
+				}
+			}
+		};
+		detail::run_workers(threads, join);
+	}
+
+}  // namespace fefu
@@ -1,14 +1,261 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
 #include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FEFU_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define FEFU_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(no_unique_address)
+#define FEFU_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+#endif
+#ifndef FEFU_NO_UNIQUE_ADDRESS
+#define FEFU_NO_UNIQUE_ADDRESS
+#endif
+
+#include "hash.hpp"
+#include "frozen_hash_map.hpp"
 
 namespace fefu {
 
+	namespace detail {
+
+		// slot states kept in the control metadata.
+		constexpr char slot_empty = 0;
+		constexpr char slot_full = 1;
+		constexpr char slot_deleted = 2;
+
+		inline unsigned count_trailing_zeros(uint32_t x) noexcept {
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, x);
+			return static_cast<unsigned>(index);
+#else
+			return static_cast<unsigned>(__builtin_ctz(x));
+#endif
+		}
+
+		inline unsigned count_trailing_zeros(uint64_t x) noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index;
+			_BitScanForward64(&index, x);
+			return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+			uint32_t low = static_cast<uint32_t>(x);
+			return low != 0 ? count_trailing_zeros(low) : 32 + count_trailing_zeros(static_cast<uint32_t>(x >> 32));
+#else
+			return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+		}
+
+		/// True when keys can be compared with == on their bits, so a scan over
+		/// them can use vector compares.
+		template <typename K, typename Pred>
+		struct is_scannable_key : std::bool_constant<
+			(std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>) &&
+			(std::is_same_v<Pred, std::equal_to<K>> || std::is_same_v<Pred, std::equal_to<>>)> {};
+
+		/// Linear probe from start over a table of capacity slots, stopping at an
+		/// empty slot or at a full one where matches(index) holds. Returns the
+		/// matching slot, else the first deleted slot passed, else the empty one;
+		/// returns capacity when the walk wraps around without passing a deleted
+		/// slot. A compile-time capacity turns the modulo into a mask.
+		template <typename State, typename Matches>
+		constexpr std::size_t linear_probe(std::size_t start, std::size_t capacity,
+			State&& state_at, Matches&& matches, std::size_t& probes) {
+			std::size_t first_deleted = capacity;
+			std::size_t index = start;
+			probes = 1;
+			char state = state_at(index);
+			while (state == slot_deleted || (state == slot_full && !matches(index))) {
+				if (first_deleted == capacity && state == slot_deleted) {
+					first_deleted = index;
+				}
+
+				index = (index + 1) % capacity;
+				if (index == start) {
+					return first_deleted;
+				}
+				state = state_at(index);
+				probes++;
+			}
+			return (state == slot_full || first_deleted == capacity ? index : first_deleted);
+		}
+
+		/// True when both the hasher and the key comparator accept any key-like type.
+		template <typename Hash, typename Pred, typename = void>
+		struct is_transparent_lookup : std::false_type {};
+
+		template <typename Hash, typename Pred>
+		struct is_transparent_lookup<Hash, Pred,
+			std::void_t<typename Hash::is_transparent, typename Pred::is_transparent>> : std::true_type {};
+
+		/// True when emplace() gets a key and a mapped value, so the key can be
+		/// looked up before the element is built.
+		template <typename Key, typename... _Args>
+		struct is_key_value_args : std::false_type {};
+
+		template <typename Key, typename _Kx, typename _V>
+		struct is_key_value_args<Key, _Kx, _V> : std::is_same<Key, std::decay_t<_Kx>> {};
+
+		/// True when emplace() gets a single pair whose first member is a key.
+		template <typename Key, typename _P>
+		struct is_pair_with_key : std::false_type {};
+
+		template <typename Key, typename _A, typename _B>
+		struct is_pair_with_key<Key, std::pair<_A, _B>> : std::is_same<Key, std::remove_const_t<_A>> {};
+
+		template <typename Key, typename... _Args>
+		struct is_key_pair_arg : std::false_type {};
+
+		template <typename Key, typename _P>
+		struct is_key_pair_arg<Key, _P> : is_pair_with_key<Key, std::decay_t<_P>> {};
+
+		inline unsigned popcount(uint64_t x) noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+			return static_cast<unsigned>(__popcnt64(x));
+#elif defined(_MSC_VER)
+			return static_cast<unsigned>(__popcnt(static_cast<uint32_t>(x)) + __popcnt(static_cast<uint32_t>(x >> 32)));
+#else
+			return static_cast<unsigned>(__builtin_popcountll(x));
+#endif
+		}
+
+		/// Number of bits needed to represent x: 0 for 0, else one more than
+		/// the index of the highest set bit.
+		inline unsigned bit_width(uint64_t x) noexcept {
+			if (x == 0) {
+				return 0;
+			}
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index;
+			_BitScanReverse64(&index, x);
+			return static_cast<unsigned>(index) + 1;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			if (_BitScanReverse(&index, static_cast<unsigned long>(x >> 32))) {
+				return static_cast<unsigned>(index) + 33;
+			}
+			_BitScanReverse(&index, static_cast<unsigned long>(x));
+			return static_cast<unsigned>(index) + 1;
+#else
+			return static_cast<unsigned>(64 - __builtin_clzll(x));
+#endif
+		}
+
+		inline uint64_t reverse_bits(uint64_t x) noexcept {
+#if defined(__clang__)
+			return __builtin_bitreverse64(x);
+#else
+			x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+			x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+			x = ((x >> 4) & 0x0f0f0f0f0f0f0f0full) | ((x & 0x0f0f0f0f0f0f0f0full) << 4);
+#if defined(_MSC_VER)
+			return _byteswap_uint64(x);
+#else
+			return __builtin_bswap64(x);
+#endif
+#endif
+		}
+
+		/// Hints the cache line holding p into all cache levels.
+		inline void prefetch(const void* p) noexcept {
+#if defined(_MSC_VER) && defined(FEFU_HAS_SSE2)
+			_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+			__builtin_prefetch(p);
+#else
+			(void)p;
+#endif
+		}
+
+		/// Returns the first control byte in [first, last) equal to value, or
+		/// last if there is none. Scans 32 (AVX2) or 16 (SSE2) bytes per step.
+		inline const char* find_byte(const char* first, const char* last, char value) noexcept {
+#if defined(FEFU_HAS_AVX2)
+			const __m256i match32 = _mm256_set1_epi8(value);
+			while (last - first >= 32) {
+				__m256i ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+				uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, match32)));
+				if (mask != 0) {
+					return first + count_trailing_zeros(mask);
+				}
+				first += 32;
+			}
+#endif
+#if defined(FEFU_HAS_SSE2)
+			const __m128i match16 = _mm_set1_epi8(value);
+			while (last - first >= 16) {
+				__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+				uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, match16)));
+				if (mask != 0) {
+					return first + count_trailing_zeros(mask);
+				}
+				first += 16;
+			}
+#endif
+			while (first != last && *first != value) {
+				first++;
+			}
+			return first;
+		}
+
+		/// Returns the first control byte in [first, last) that marks a full slot.
+		inline const char* find_full(const char* first, const char* last) noexcept {
+			return find_byte(first, last, slot_full);
+		}
+
+		/// True when Hash has an operator==.
+		template <typename Hash, typename = void>
+		struct is_equality_comparable : std::false_type {};
+
+		template <typename Hash>
+		struct is_equality_comparable<Hash, std::void_t<decltype(std::declval<const Hash&>() == std::declval<const Hash&>())>>
+			: std::true_type {};
+
+		/// True when a and b give every key the same hash: they compare equal,
+		/// or Hash has no state to differ in.
+		template <typename Hash>
+		bool same_hashing(const Hash& a, const Hash& b) {
+			if constexpr (is_equality_comparable<Hash>::value) {
+				return static_cast<bool>(a == b);
+			} else {
+				return std::is_empty_v<Hash>;
+			}
+		}
+
+		/// True when the metadata policy can empty a table through next_generation().
+		template <typename Metadata, typename = void>
+		struct has_generations : std::false_type {};
+
+		template <typename Metadata>
+		struct has_generations<Metadata, std::void_t<decltype(Metadata::next_generation(
+			std::declval<typename Metadata::word_type*>(), std::size_t()))>> : std::true_type {};
+
+	}  // namespace detail
+
 	template <typename T>
 	class allocator {
 	public:
@@ -45,24 +292,372 @@ namespace fefu {
 		void deallocate(pointer p, size_type n) noexcept { ::operator delete(p, n * sizeof(value_type)); }
 	};
 
-	template <typename ValueType>
+	/// Control metadata with one byte per slot. Full slots are found
+	/// with SIMD scans over the control bytes.
+	struct byte_metadata {
+		using word_type = char;
+
+		static std::size_t words(std::size_t capacity) noexcept { return capacity; }
+
+		static void reset(word_type* meta, std::size_t capacity) noexcept {
+			std::fill_n(meta, capacity, detail::slot_empty);
+		}
+
+		static char get(const word_type* meta, std::size_t i) noexcept { return meta[i]; }
+		static void set(word_type* meta, std::size_t i, char state) noexcept { meta[i] = state; }
+
+		/// Returns the first full slot in [i, capacity), or capacity.
+		static std::size_t next_full(const word_type* meta, std::size_t i, std::size_t capacity) noexcept {
+			return detail::find_full(meta + i, meta + capacity) - meta;
+		}
+
+		static std::size_t count(const word_type* meta, std::size_t capacity, char state) noexcept {
+			return std::count(meta, meta + capacity, state);
+		}
+	};
+
+	/// Control metadata packed into 2 bits per slot, 32 slots per 64-bit word.
+	/// Uses a quarter of the memory of byte_metadata; scans go a word at a time.
+	struct packed_metadata {
+		using word_type = uint64_t;
+
+		static constexpr uint64_t low_bits = 0x5555555555555555ull;
+
+		static std::size_t words(std::size_t capacity) noexcept { return (capacity + 31) / 32; }
+
+		static void reset(word_type* meta, std::size_t capacity) noexcept {
+			std::fill_n(meta, words(capacity), static_cast<word_type>(0));
+		}
+
+		static char get(const word_type* meta, std::size_t i) noexcept {
+			return static_cast<char>((meta[i >> 5] >> ((i & 31) * 2)) & 3);
+		}
+		static void set(word_type* meta, std::size_t i, char state) noexcept {
+			unsigned shift = static_cast<unsigned>(i & 31) * 2;
+			meta[i >> 5] = (meta[i >> 5] & ~(static_cast<word_type>(3) << shift))
+				| (static_cast<word_type>(state) << shift);
+		}
+
+		/// Returns the first full slot in [i, capacity), or capacity.
+		static std::size_t next_full(const word_type* meta, std::size_t i, std::size_t capacity) noexcept {
+			if (i >= capacity) {
+				return capacity;
+			}
+
+			std::size_t w = i >> 5;
+			std::size_t last = words(capacity);
+			word_type bits = full_bits(meta[w]) & (~static_cast<word_type>(0) << ((i & 31) * 2));
+			while (bits == 0) {
+				if (++w == last) {
+					return capacity;
+				}
+				bits = full_bits(meta[w]);
+			}
+
+			std::size_t index = (w << 5) + detail::count_trailing_zeros(bits) / 2;
+			return std::min(index, capacity);
+		}
+
+		static std::size_t count(const word_type* meta, std::size_t capacity, char state) noexcept {
+			std::size_t result = 0;
+			std::size_t last = words(capacity);
+			for (std::size_t w = 0; w < last; w++) {
+				word_type bits = state_bits(meta[w], state);
+				if (w + 1 == last && (capacity & 31) != 0) {
+					bits &= (static_cast<word_type>(1) << ((capacity & 31) * 2)) - 1;
+				}
+				result += detail::popcount(bits);
+			}
+			return result;
+		}
+
+	private:
+		// one bit (the lower bit of each pair) per slot whose state is full.
+		static word_type full_bits(word_type w) noexcept {
+			return w & ~(w >> 1) & low_bits;
+		}
+
+		static word_type state_bits(word_type w, char state) noexcept {
+			word_type lo = (state & 1) ? w : ~w;
+			word_type hi = (state & 2) ? (w >> 1) : ~(w >> 1);
+			return lo & hi & low_bits;
+		}
+	};
+
+	/// One control byte per slot holding the slot state and the generation it
+	/// was written in; bytes from an older generation read as empty. The
+	/// current generation sits in a header byte, so next_generation() empties
+	/// the table in O(1), with a real reset once every 63 generations.
+	struct generation_metadata {
+		using word_type = char;
+
+		static constexpr unsigned max_generation = 63;
+
+		static std::size_t words(std::size_t capacity) noexcept { return capacity + 1; }
+
+		static void reset(word_type* meta, std::size_t capacity) noexcept {
+			meta[0] = 1;
+			std::fill_n(meta + 1, capacity, static_cast<word_type>(0));
+		}
+
+		static char get(const word_type* meta, std::size_t i) noexcept {
+			unsigned char b = static_cast<unsigned char>(meta[i + 1]);
+			return (b >> 2) == static_cast<unsigned char>(meta[0]) ? static_cast<char>(b & 3) : detail::slot_empty;
+		}
+		static void set(word_type* meta, std::size_t i, char state) noexcept {
+			meta[i + 1] = (state == detail::slot_empty ? 0 : tag(meta, state));
+		}
+
+		/// Returns the first full slot in [i, capacity), or capacity.
+		static std::size_t next_full(const word_type* meta, std::size_t i, std::size_t capacity) noexcept {
+			return detail::find_byte(meta + 1 + i, meta + 1 + capacity, tag(meta, detail::slot_full)) - (meta + 1);
+		}
+
+		static std::size_t count(const word_type* meta, std::size_t capacity, char state) noexcept {
+			if (state == detail::slot_empty) {
+				return capacity - count(meta, capacity, detail::slot_full) - count(meta, capacity, detail::slot_deleted);
+			}
+			return std::count(meta + 1, meta + 1 + capacity, tag(meta, state));
+		}
+
+		/// Empties every slot by moving to the next generation.
+		static void next_generation(word_type* meta, std::size_t capacity) noexcept {
+			if (static_cast<unsigned char>(meta[0]) == max_generation) {
+				reset(meta, capacity);
+			} else {
+				meta[0]++;
+			}
+		}
+
+	private:
+		static char tag(const word_type* meta, char state) noexcept {
+			return static_cast<char>((static_cast<unsigned char>(meta[0]) << 2) | state);
+		}
+	};
+
+	/// Snapshot returned by hash_map::stats().
+	struct hash_map_stats {
+		static constexpr std::size_t histogram_size = 17;
+
+		/// probe_histogram[i] counts lookups that inspected i + 1 slots;
+		/// the last entry collects every longer probe.
+		std::array<std::size_t, histogram_size> probe_histogram{};
+		std::size_t max_displacement = 0;
+		std::size_t tombstones = 0;
+		std::size_t rehash_count = 0;
+		std::size_t realloc_count = 0;
+		std::chrono::nanoseconds rehash_time{ 0 };
+		std::size_t metadata_bytes = 0;
+		std::size_t data_bytes = 0;
+		std::size_t find_hits = 0;
+		std::size_t find_misses = 0;
+	};
+
+	/// Stats policy that records nothing; every hook compiles away.
+	struct no_stats {
+		static constexpr bool enabled = false;
+
+		void on_probe(std::size_t) noexcept {}
+		void on_find(bool) noexcept {}
+		void on_allocate() noexcept {}
+		void on_rehash(std::chrono::nanoseconds) noexcept {}
+	};
+
+	/// Stats policy that keeps the counters reported by hash_map::stats().
+	struct collect_stats {
+		static constexpr bool enabled = true;
+
+		void on_probe(std::size_t length) noexcept {
+			probes_[std::min(length, hash_map_stats::histogram_size) - 1]++;
+		}
+		void on_find(bool hit) noexcept { (hit ? hits_ : misses_)++; }
+		void on_allocate() noexcept { reallocs_++; }
+		void on_rehash(std::chrono::nanoseconds elapsed) noexcept {
+			rehashes_++;
+			rehash_time_ += elapsed;
+		}
+
+		void fill(hash_map_stats& out) const noexcept {
+			out.probe_histogram = probes_;
+			out.rehash_count = rehashes_;
+			out.realloc_count = reallocs_;
+			out.rehash_time = rehash_time_;
+			out.find_hits = hits_;
+			out.find_misses = misses_;
+		}
+
+	private:
+		std::array<std::size_t, hash_map_stats::histogram_size> probes_{};
+		std::size_t rehashes_ = 0;
+		std::size_t reallocs_ = 0;
+		std::chrono::nanoseconds rehash_time_{ 0 };
+		std::size_t hits_ = 0;
+		std::size_t misses_ = 0;
+	};
+
+	// growth policies. A policy picks the bucket counts a table may have and
+	// maps a hash to its home slot; the instance is prepared for one bucket
+	// count, so it can keep per-size state such as a precomputed divisor.
+
+	/// Keeps the requested bucket count and grows it by Num/Den (at least by
+	/// one). Power-of-two counts mask the hash, after mixing it unless the
+	/// hasher is avalanching; other counts reduce it with a modulo.
+	template <std::size_t Num, std::size_t Den>
+	struct factor_growth {
+		static_assert(Num > Den && Den > 0, "growth factor must be greater than 1");
+
+		std::size_t capacity_for(std::size_t n) const noexcept { return std::max(static_cast<std::size_t>(1), n); }
+		std::size_t next_capacity(std::size_t capacity) const noexcept {
+			return std::max(capacity + 1, capacity * Num / Den);
+		}
+		void prepare(std::size_t) noexcept {}
+
+		template <bool Avalanching>
+		std::size_t index(std::size_t hash, std::size_t capacity) const noexcept {
+			if ((capacity & (capacity - 1)) == 0) {
+				if constexpr (!Avalanching) {
+					hash = static_cast<std::size_t>(detail::mix64(hash));
+				}
+				return hash & (capacity - 1);
+			}
+			return hash % capacity;
+		}
+	};
+
+	/// Default policy: exact bucket counts, doubled on growth.
+	using doubling_growth = factor_growth<2, 1>;
+
+	/// Grows by half, trading more frequent rehashes for less memory.
+	using one_and_half_growth = factor_growth<3, 2>;
+
+	/// Rounds every bucket count up to a power of two, so the home slot is
+	/// always a mask of the (mixed, unless avalanching) hash.
+	struct power_of_two_growth {
+		std::size_t capacity_for(std::size_t n) const noexcept {
+			std::size_t capacity = 1;
+			while (capacity < n) {
+				capacity <<= 1;
+			}
+			return capacity;
+		}
+		std::size_t next_capacity(std::size_t capacity) const noexcept { return capacity * 2; }
+		void prepare(std::size_t) noexcept {}
+
+		template <bool Avalanching>
+		constexpr std::size_t index(std::size_t hash, std::size_t capacity) const noexcept {
+			if constexpr (!Avalanching) {
+				hash = static_cast<std::size_t>(detail::mix64(hash));
+			}
+			return hash & (capacity - 1);
+		}
+	};
+
+	/// Bucket counts from a table of primes just above each power of two.
+	/// A prime modulo uses every bit of the hash, so weak hashers need no
+	/// mixing; the division is replaced by Lemire's fastmod with a reciprocal
+	/// computed once per bucket count.
+	struct prime_growth {
+		static constexpr std::size_t prime_count = 63;
+
+		std::size_t capacity_for(std::size_t n) const noexcept {
+			const uint64_t* p = std::lower_bound(primes(), primes() + prime_count, static_cast<uint64_t>(n));
+			return p == primes() + prime_count ? n : static_cast<std::size_t>(*p);
+		}
+		std::size_t next_capacity(std::size_t capacity) const noexcept {
+			return capacity_for(capacity + 1);
+		}
+
+		void prepare(std::size_t capacity) noexcept {
+#if defined(__SIZEOF_INT128__)
+			// M = ceil(2^128 / d), wrapping to 0 for d == 1.
+			reciprocal_ = ~static_cast<__uint128_t>(0) / (capacity == 0 ? 1 : capacity) + 1;
+#else
+			(void)capacity;
+#endif
+		}
+
+		template <bool>
+		std::size_t index(std::size_t hash, std::size_t capacity) const noexcept {
+#if defined(__SIZEOF_INT128__)
+			__uint128_t low = reciprocal_ * static_cast<uint64_t>(hash);
+			__uint128_t bottom = (static_cast<__uint128_t>(static_cast<uint64_t>(low)) * capacity) >> 64;
+			__uint128_t top = static_cast<__uint128_t>(static_cast<uint64_t>(low >> 64)) * capacity;
+			return static_cast<std::size_t>((bottom + top) >> 64);
+#else
+			return hash % capacity;
+#endif
+		}
+
+		static const uint64_t* primes() noexcept {
+			static constexpr uint64_t table[prime_count] = {
+				2ull, 5ull, 11ull, 17ull,
+				37ull, 67ull, 131ull, 257ull,
+				521ull, 1031ull, 2053ull, 4099ull,
+				8209ull, 16411ull, 32771ull, 65537ull,
+				131101ull, 262147ull, 524309ull, 1048583ull,
+				2097169ull, 4194319ull, 8388617ull, 16777259ull,
+				33554467ull, 67108879ull, 134217757ull, 268435459ull,
+				536870923ull, 1073741827ull, 2147483659ull, 4294967311ull,
+				8589934609ull, 17179869209ull, 34359738421ull, 68719476767ull,
+				137438953481ull, 274877906951ull, 549755813911ull, 1099511627791ull,
+				2199023255579ull, 4398046511119ull, 8796093022237ull, 17592186044423ull,
+				35184372088891ull, 70368744177679ull, 140737488355333ull, 281474976710677ull,
+				562949953421381ull, 1125899906842679ull, 2251799813685269ull, 4503599627370517ull,
+				9007199254740997ull, 18014398509482143ull, 36028797018963971ull, 72057594037928017ull,
+				144115188075855881ull, 288230376151711813ull, 576460752303423619ull, 1152921504606847009ull,
+				2305843009213693967ull, 4611686018427388039ull, 9223372036854775837ull,
+			};
+			return table;
+		}
+
+	private:
+#if defined(__SIZEOF_INT128__)
+		__uint128_t reciprocal_ = 0;
+#endif
+	};
+
+	/// Saved position of a hash_map element: its slot and the generation of
+	/// the table it was taken from. Half the size of an iterator, and a
+	/// rehash makes it stale instead of dangling (see hash_map::get).
+	struct slot_handle {
+		std::size_t index = 0;
+		std::size_t generation = 0;
+	};
+
+	template <typename ValueType, typename Metadata = byte_metadata>
 	class Node {
 	public:
 		using pointer = ValueType*;
+		using word_type = typename Metadata::word_type;
+
+		Node(pointer dptr, word_type* uptr, std::size_t index, std::size_t capacity)
+			: dptr_(dptr), uptr_(uptr), index_(index), capacity_(capacity) {}
+
+		/// Moves to the next full slot, or to the end position.
+		void advance() {
+			if (index_ == capacity_) {
+				throw std::runtime_error("Out of bounds");
+			}
+
+			std::size_t next = Metadata::next_full(uptr_, index_ + 1, capacity_);
+			dptr_ += next - index_;
+			index_ = next;
+		}
 
-		Node(pointer dptr, char* uptr, char* eptr) : dptr_(dptr), uptr_(uptr), eptr_(eptr) {}
+		bool valid() const noexcept { return dptr_ != nullptr && uptr_ != nullptr; }
 
 		pointer dptr_;
-		char* uptr_;
-		char* eptr_;
+		word_type* uptr_;
+		std::size_t index_;
+		std::size_t capacity_;
 	};
 
-	template <typename ValueType>
+	template <typename ValueType, typename Metadata = byte_metadata>
 	class hash_map_iterator {
-		template <typename K, typename T, typename Hash, typename Pred,typename Alloc>
+		template <typename K, typename T, typename Hash, typename Pred, typename Alloc, typename Meta, typename Stats, typename Growth>
 		friend class hash_map;
 
-		template <typename>
+		template <typename, typename>
 		friend class hash_map_const_iterator;
 	public:
 		using iterator_category = std::forward_iterator_tag;
@@ -72,20 +667,19 @@ namespace fefu {
 		using pointer = ValueType*;
 
 		hash_map_iterator() noexcept
-			: node(nullptr, nullptr, nullptr) {
-		}
-		hash_map_iterator(const hash_map_iterator& other) noexcept
-			: node(other.node.dptr_, other.node.uptr_, other.node.eptr_) {
+			: node(nullptr, nullptr, 0, 0) {
 		}
+		hash_map_iterator(const hash_map_iterator& other) noexcept = default;
+		hash_map_iterator& operator=(const hash_map_iterator& other) noexcept = default;
 
 		reference operator*() const { 
-			if (node.dptr_ == nullptr || node.eptr_ == nullptr || node.uptr_ == nullptr) {
+			if (!node.valid()) {
 				throw std::runtime_error("Uninit iterator");
 			}
 			return *node.dptr_;
 		}
 		pointer operator->() const {
-			if (node.dptr_ == nullptr || node.eptr_ == nullptr || node.uptr_ == nullptr) {
+			if (!node.valid()) {
 				throw std::runtime_error("Uninit iterator");
 			}
 			return node.dptr_;
@@ -93,18 +687,7 @@ namespace fefu {
 
 		// prefix ++
 		hash_map_iterator& operator++() {
-			if (node.uptr_ != node.eptr_) {
-				node.uptr_++;
-				node.dptr_++;
-
-				while (node.uptr_ != node.eptr_ && *node.uptr_ != 1) {
-					node.dptr_++;
-					node.uptr_++;
-				}
-			} else {
-				throw std::runtime_error("Out of bounds");
-			}
-
+			node.advance();
 			return *this;
 		}
 		// postfix ++
@@ -114,22 +697,26 @@ namespace fefu {
 			return result;
 		}
 
-		friend bool operator==(const hash_map_iterator<ValueType>& lhs,
-			const hash_map_iterator<ValueType>& rhs) {
+		friend bool operator==(const hash_map_iterator& lhs,
+			const hash_map_iterator& rhs) {
 			return &*lhs == &*rhs;
 		}
-		friend bool operator!=(const hash_map_iterator<ValueType>& lhs,
-			const hash_map_iterator<ValueType>& rhs) {
+		friend bool operator!=(const hash_map_iterator& lhs,
+			const hash_map_iterator& rhs) {
 			return &*lhs != &*rhs;
 		}
 
 	private:
-		Node<ValueType> node;
+		hash_map_iterator(const Node<ValueType, Metadata>& n) noexcept
+			: node(n) {
+		}
+
+		Node<ValueType, Metadata> node;
 	};
 
-	template <typename ValueType>
+	template <typename ValueType, typename Metadata = byte_metadata>
 	class hash_map_const_iterator {
-		template <typename K, typename T, typename Hash, typename Pred, typename Alloc>
+		template <typename K, typename T, typename Hash, typename Pred, typename Alloc, typename Meta, typename Stats, typename Growth>
 		friend class hash_map;
 	public:
 		using iterator_category = std::forward_iterator_tag;
@@ -139,23 +726,22 @@ namespace fefu {
 		using pointer = const ValueType*;
 
 		hash_map_const_iterator() noexcept
-			: node(nullptr, nullptr, nullptr) {
-		}
-		hash_map_const_iterator(const hash_map_const_iterator& other) noexcept
-			: node(other.node.dptr_, other.node.uptr_, other.node.eptr_) {
+			: node(nullptr, nullptr, 0, 0) {
 		}
-		hash_map_const_iterator(const hash_map_iterator<ValueType>& other) noexcept
-			: node(other.node.dptr_, other.node.uptr_, other.node.eptr_) {
+		hash_map_const_iterator(const hash_map_const_iterator& other) noexcept = default;
+		hash_map_const_iterator& operator=(const hash_map_const_iterator& other) noexcept = default;
+		hash_map_const_iterator(const hash_map_iterator<ValueType, Metadata>& other) noexcept
+			: node(other.node) {
 		}
 
 		reference operator*() const {
-			if (node.dptr_ == nullptr || node.eptr_ == nullptr || node.uptr_ == nullptr) {
+			if (!node.valid()) {
 				throw std::runtime_error("Uninit iterator");
 			}
 			return *node.dptr_;
 		}
 		pointer operator->() const {
-			if (node.dptr_ == nullptr || node.eptr_ == nullptr || node.uptr_ == nullptr) {
+			if (!node.valid()) {
 				throw std::runtime_error("Uninit iterator");
 			}
 			return node.dptr_;
@@ -163,18 +749,7 @@ namespace fefu {
 
 		// prefix ++
 		hash_map_const_iterator& operator++() {
-			if (node.uptr_ != node.eptr_) {
-				node.uptr_++;
-				node.dptr_++;
-
-				while (node.uptr_ != node.eptr_ && *node.uptr_ != 1) {
-					node.dptr_++;
-					node.uptr_++;
-				}
-			} else {
-				throw std::runtime_error("Out of bounds");
-			}
-
+			node.advance();
 			return *this;
 		}
 		// postfix ++
@@ -184,22 +759,29 @@ namespace fefu {
 			return result;
 		}
 
-		friend bool operator==(const hash_map_const_iterator<ValueType>& lhs,
-			const hash_map_const_iterator<ValueType>& rhs) {
+		friend bool operator==(const hash_map_const_iterator& lhs,
+			const hash_map_const_iterator& rhs) {
 			return &*lhs == &*rhs;
 		}
-		friend bool operator!=(const hash_map_const_iterator<ValueType>& lhs,
-			const hash_map_const_iterator<ValueType>& rhs) {
+		friend bool operator!=(const hash_map_const_iterator& lhs,
+			const hash_map_const_iterator& rhs) {
 			return &*lhs != &*rhs;
 		}
 
 	private:
-		Node<ValueType> node;
+		hash_map_const_iterator(const Node<ValueType, Metadata>& n) noexcept
+			: node(n) {
+		}
+
+		Node<ValueType, Metadata> node;
 	};
 
 	template <typename K, typename T, typename Hash = std::hash<K>,
 		typename Pred = std::equal_to<K>,
-		typename Alloc = allocator<std::pair<const K, T>>>
+		typename Alloc = allocator<std::pair<const K, T>>,
+		typename Metadata = byte_metadata,
+		typename Stats = no_stats,
+		typename GrowthPolicy = doubling_growth>
 		class hash_map {
 		public:
 			using key_type = K;
@@ -210,16 +792,19 @@ namespace fefu {
 			using value_type = std::pair<const key_type, mapped_type>;
 			using reference = value_type&;
 			using const_reference = const value_type&;
-			using iterator = hash_map_iterator<value_type>;
-			using const_iterator = hash_map_const_iterator<value_type>;
+			using iterator = hash_map_iterator<value_type, Metadata>;
+			using const_iterator = hash_map_const_iterator<value_type, Metadata>;
 			using size_type = std::size_t;
+			using metadata_type = Metadata;
+			using stats_type = Stats;
+			using growth_policy = GrowthPolicy;
 
 			hash_map() : hash_map(1) {}
 
 			~hash_map() {
 				if (data_ != nullptr) {
 					for (size_type i = 0; i < capacity_; i++) {
-						if (used_[i] == 1) {
+						if (Metadata::get(used_, i) == detail::slot_full) {
 							data_[i].~value_type();
 						}
 					}
@@ -231,10 +816,27 @@ namespace fefu {
 			explicit hash_map(size_type n)
 				: hasher_(), allocator_(), pred_(), max_load_factor_(0.45f), length_(0) {
 				
-				capacity_ = std::max(static_cast<size_type>(1), n);
-				used_ = new char[capacity_];
+				capacity_ = growth_.capacity_for(n);
+				growth_.prepare(capacity_);
+				first_ = capacity_;
+				used_ = new word_type[Metadata::words(capacity_)];
 				data_ = allocator_.allocate(capacity_);
-				std::fill_n(used_, capacity_, static_cast<char>(0));
+				stats_.on_allocate();
+				Metadata::reset(used_, capacity_);
+			}
+
+			///  Like hash_map(n), hashing and comparing with copies of hf and eql;
+			///  maps built from one seeded hasher accept the same hash_of() values.
+			hash_map(size_type n, const hasher& hf, const key_equal& eql = key_equal())
+				: hasher_(hf), allocator_(), pred_(eql), max_load_factor_(0.45f), length_(0) {
+
+				capacity_ = growth_.capacity_for(n);
+				growth_.prepare(capacity_);
+				first_ = capacity_;
+				used_ = new word_type[Metadata::words(capacity_)];
+				data_ = allocator_.allocate(capacity_);
+				stats_.on_allocate();
+				Metadata::reset(used_, capacity_);
 			}
 
 			template <typename InputIterator>
@@ -244,19 +846,23 @@ namespace fefu {
 			}
 
 			hash_map(const hash_map& other)
-				: hasher_(other.hasher_), allocator_(other.allocator_), pred_(other.pred_),
-				max_load_factor_(0.45f),
-				used_(new char[other.capacity_]),
+				: hasher_(other.hasher_), allocator_(other.allocator_), pred_(other.pred_), growth_(other.growth_),
+				max_load_factor_(other.max_load_factor_),
+				used_(new word_type[Metadata::words(other.capacity_)]),
 				length_(other.length_),
-				capacity_(other.capacity_) {
+				capacity_(other.capacity_),
+				first_(other.first_),
+				min_load_factor_(other.min_load_factor_),
+				max_probe_length_(other.max_probe_length_), reseed_count_(other.reseed_count_) {
 				data_ = allocator_.allocate(other.capacity_);
+				stats_.on_allocate();
 
 				for (size_type i = 0; i < other.capacity_; i++) {
-					if (other.used_[i] == 1) {
+					if (Metadata::get(other.used_, i) == detail::slot_full) {
 						new(data_ + i) value_type(other.data_[i]);
 					}
-					used_[i] = other.used_[i];
 				}
+				std::copy_n(other.used_, Metadata::words(capacity_), used_);
 			}
 
 			hash_map(hash_map&& other)
@@ -264,60 +870,79 @@ namespace fefu {
 				max_load_factor_ = 0.45f;
 				capacity_ = 0;
 				length_ = 0;
+				first_ = 0;
 
 				std::swap(other.data_, data_);
                                 std::swap(other.used_, used_);
                                 std::swap(other.length_, length_);
                                 std::swap(other.capacity_, capacity_);
+                                std::swap(other.first_, first_);
+                                std::swap(other.growth_, growth_);
                                 std::swap(other.max_load_factor_, max_load_factor_);
+                                std::swap(other.min_load_factor_, min_load_factor_);
+                                std::swap(other.max_probe_length_, max_probe_length_);
+                                std::swap(other.reseed_count_, reseed_count_);
+                                std::swap(other.guard_length_, guard_length_);
+                                std::swap(other.guard_capacity_, guard_capacity_);
 			}
 
 			explicit hash_map(const allocator_type& a)
 				: hasher_(), allocator_(a), pred_(), max_load_factor_(0.45f), length_(0) {
 
-				capacity_ = 1;
-				used_ = new char[capacity_];
+				capacity_ = growth_.capacity_for(1);
+				growth_.prepare(capacity_);
+				first_ = capacity_;
+				used_ = new word_type[Metadata::words(capacity_)];
 				data_ = allocator_.allocate(capacity_);
-				std::fill_n(used_, capacity_, static_cast<char>(0));
+				stats_.on_allocate();
+				Metadata::reset(used_, capacity_);
 			}
 
 			hash_map(const hash_map& other, const allocator_type& a)
-				: hasher_(other.hasher_), allocator_(a), pred_(other.pred_),
-				max_load_factor_(0.45f),
-				used_(new char[other.capacity_]),
+				: hasher_(other.hasher_), allocator_(a), pred_(other.pred_), growth_(other.growth_),
+				max_load_factor_(other.max_load_factor_),
+				used_(new word_type[Metadata::words(other.capacity_)]),
 				length_(other.length_),
-				capacity_(other.capacity_) {
+				capacity_(other.capacity_),
+				first_(other.first_),
+				min_load_factor_(other.min_load_factor_),
+				max_probe_length_(other.max_probe_length_), reseed_count_(other.reseed_count_) {
 				data_ = allocator_.allocate(other.capacity_);
+				stats_.on_allocate();
 
 				for (size_type i = 0; i < other.capacity_; i++) {
-					if (other.used_[i] == 1) {
+					if (Metadata::get(other.used_, i) == detail::slot_full) {
 						new(data_ + i) value_type(other.data_[i]);
 					}
-					used_[i] = other.used_[i];
 				}
+				std::copy_n(other.used_, Metadata::words(capacity_), used_);
 			}
 
 			hash_map(hash_map&& other, const allocator_type& a)
-				: hasher_(std::move(other.hasher_)), allocator_(a), pred_(std::move(other.pred_)),
-				max_load_factor_(other.max_load_factor_), length_(other.length_) {
+				: hasher_(std::move(other.hasher_)), allocator_(a), pred_(std::move(other.pred_)), growth_(other.growth_),
+				max_load_factor_(other.max_load_factor_), length_(other.length_),
+				min_load_factor_(other.min_load_factor_),
+				max_probe_length_(other.max_probe_length_), reseed_count_(other.reseed_count_) {
 
 				capacity_ = other.capacity_;
-				used_ = new char[capacity_];
+				first_ = other.first_;
+				used_ = new word_type[Metadata::words(capacity_)];
 				data_ = allocator_.allocate(capacity_);
+				stats_.on_allocate();
 
 				for (size_type i = 0; i < other.capacity_; i++) {
-					if (other.used_[i] == 1) {
+					if (Metadata::get(other.used_, i) == detail::slot_full) {
 						new(data_ + i) value_type(std::move(other.data_[i]));
 					}
-					used_[i] = other.used_[i];
 				}
+				std::copy_n(other.used_, Metadata::words(capacity_), used_);
 
 				delete[] other.used_;
 				other.allocator_.deallocate(other.data_, other.capacity_);
 				
-				other.max_load_factor_ = 0.45f;
 				other.capacity_ = 0;
 				other.length_ = 0;
+				other.first_ = 0;
 				other.data_ = nullptr;
 				other.used_ = nullptr;
 			}
@@ -325,10 +950,13 @@ namespace fefu {
 			hash_map(std::initializer_list<value_type> l, size_type n = 1) 
 				: hasher_(), allocator_(), pred_(), max_load_factor_(0.45f), length_(0) {
 
-				capacity_ = std::max(l.size(), std::max(static_cast<size_type>(1), n));
-				used_ = new char[capacity_];
+				capacity_ = growth_.capacity_for(std::max(l.size(), n));
+				growth_.prepare(capacity_);
+				first_ = capacity_;
+				used_ = new word_type[Metadata::words(capacity_)];
 				data_ = allocator_.allocate(capacity_);
-				std::fill_n(used_, capacity_, static_cast<char>(0));
+				stats_.on_allocate();
+				Metadata::reset(used_, capacity_);
 
 				this->insert(l.begin(), l.end());
 			}
@@ -336,29 +964,13 @@ namespace fefu {
 
 			/// Copy assignment operator.
 			hash_map& operator=(const hash_map& other) {
-				if (data_ != nullptr) {
-					for (size_type i = 0; i < capacity_; i++) {
-						if (used_[i] == 1) {
-							data_[i].~value_type();
-						}
-					}
-					allocator_.deallocate(data_, capacity_);
-					delete[] used_;
-				}
-
-				max_load_factor_ = 0.45f;
-				length_ = other.length_;
-				capacity_ = other.capacity_;
-				data_ = allocator_.allocate(other.capacity_);
-				used_ = new char[other.capacity_];
-
-				for (size_type i = 0; i < other.capacity_; i++) {
-					if (other.used_[i] == 1) {
-						new(data_ + i) value_type(other.data_[i]);
-					}
-					used_[i] = other.used_[i];
-				}
-
+				// copy-and-swap: the hasher comes along with the table laid out
+				// under its seed, and a = a copies before anything is freed.
+				hash_map copy(other, allocator_);
+				Stats stats = stats_;
+				swap(copy);
+				stats_ = stats;
+				stats_.on_allocate();
 				return *this;
 			}
 
@@ -366,7 +978,7 @@ namespace fefu {
 			hash_map& operator=(hash_map&& other) {
 				if (data_ != nullptr) {
 					for (size_type i = 0; i < capacity_; i++) {
-						if (used_[i] == 1) {
+						if (Metadata::get(used_, i) == detail::slot_full) {
 							data_[i].~value_type();
 						}
 					}
@@ -374,9 +986,9 @@ namespace fefu {
 					delete[] used_;
 				}
 
-				max_load_factor_ = 0.45f;
 				capacity_ = 0;
 				length_ = 0;
+				first_ = 0;
 				data_ = nullptr;
 				used_ = nullptr;
 
@@ -388,7 +1000,7 @@ namespace fefu {
 			hash_map& operator=(std::initializer_list<value_type> l) {
 				if (data_ != nullptr) {
 					for (size_type i = 0; i < capacity_; i++) {
-						if (used_[i] == 1) {
+						if (Metadata::get(used_, i) == detail::slot_full) {
 							data_[i].~value_type();
 						}
 					}
@@ -396,12 +1008,15 @@ namespace fefu {
 					delete[] used_;
 				}
 
-				max_load_factor_ = 0.45f;
-				capacity_ = l.size();
+				capacity_ = growth_.capacity_for(l.size());
+				growth_.prepare(capacity_);
+				first_ = capacity_;
 				length_ = 0;
-				data_ = allocator_.allocate(l.size());
-				used_ = new char[l.size()]();
-				std::fill_n(used_, capacity_, static_cast<char>(0));
+				data_ = allocator_.allocate(capacity_);
+				stats_.on_allocate();
+				used_ = new word_type[Metadata::words(capacity_)];
+				Metadata::reset(used_, capacity_);
+				table_generation_++;
 				for (auto& vls : l) {
 					this->operator[](vls.first) = vls.second;
 				}
@@ -421,151 +1036,109 @@ namespace fefu {
 
 			// iterators.
 			iterator begin() noexcept {
-				iterator rtn_iter = this->end();
-				for (size_type i = 0; i < capacity_; i++) {
-					if (used_[i] != 0) {
-						rtn_iter.node.uptr_ = used_ + i;
-						rtn_iter.node.dptr_ = data_ + i;
-						rtn_iter.node.eptr_ = used_ + capacity_;
-						break;
-					}
-				}
-				return rtn_iter;
+				return iterator(node_at(first_));
 			}
 
 			const_iterator begin() const noexcept { return cbegin(); }
 			const_iterator cbegin() const noexcept {
-				const_iterator rtn_iter = this->end();
-				for (size_type i = 0; i < capacity_; i++) {
-					if (used_[i] != 0) {
-						rtn_iter.node.uptr_ = used_ + i;
-						rtn_iter.node.dptr_ = data_ + i;
-						rtn_iter.node.eptr_ = used_ + capacity_;
-						break;
-					}
-				}
-				return rtn_iter;
+				return const_iterator(node_at(first_));
 			}
 
 			iterator end() noexcept {
-				iterator rtn_iter;
-
-				rtn_iter.node.uptr_ = used_ + capacity_;
-				rtn_iter.node.dptr_ = data_ + capacity_;
-				rtn_iter.node.eptr_ = used_ + capacity_;
-
-				return rtn_iter;
+				return iterator(node_at(capacity_));
 			}
 
 			const_iterator end() const noexcept { return cend(); }
 			const_iterator cend() const noexcept {
-				const_iterator rtn_iter;
-
-				rtn_iter.node.uptr_ = used_ + capacity_;
-				rtn_iter.node.dptr_ = data_ + capacity_;
-				rtn_iter.node.eptr_ = used_ + capacity_;
-
-				return rtn_iter;
+				return const_iterator(node_at(capacity_));
 			}
 
-			// modifiers.
-			template <typename... _Args>
-			std::pair<iterator, bool> emplace(_Args&&... args) {
-				return this->insert(value_type(std::forward<_Args>(args)...));
+			///  Calls visit(value) for every element, skipping empty and deleted
+			///  slots a vector of control bytes at a time.
+			template <typename _Visitor>
+			void for_each_slot(_Visitor&& visit) {
+				for (size_type i = first_; i != capacity_; i = Metadata::next_full(used_, i + 1, capacity_)) {
+					visit(data_[i]);
+				}
 			}
 
-			template <typename... _Args>
-			std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
-				size_type index = custom_bucket(k, data_, used_, capacity_);
-				if (index == capacity_ || load_factor() > max_load_factor()) {
-					this->rehash(2 * this->bucket_count());
-					index = custom_bucket(k, data_, used_, capacity_);
+			template <typename _Visitor>
+			void for_each_slot(_Visitor&& visit) const {
+				for (size_type i = first_; i != capacity_; i = Metadata::next_full(used_, i + 1, capacity_)) {
+					visit(static_cast<const_reference>(data_[i]));
 				}
+			}
 
-				if (used_[index] != 1) {
-					new (data_ + index) value_type(k, mapped_type(std::forward<_Args>(args)...)); // todo: maybe forward
-					used_[index] = 1;
-					length_++;
-				} else {
-					return { this->end(), false };
+			///  Incremental walk that survives rehashes, as Redis SCAN does. Start
+			///  with cursor 0 and pass the returned cursor to the next call until
+			///  it returns 0. Each call calls visit(value) for the elements of
+			///  whole home buckets until count elements were visited (or 10 *
+			///  count buckets were looked at). Buckets are taken in reverse-bit
+			///  order, so when the table doubles or halves between calls the
+			///  buckets already done map onto buckets that stay done.
+			///
+			///  Every element present from the first call to the last is visited
+			///  at least once; some may be visited twice, elements inserted or
+			///  erased meanwhile may or may not be. visit must not modify the
+			///  map, but the map may be modified between calls. A reseed by the
+			///  probe-length guard moves every element; restart the scan when
+			///  reseed_count() changed if that matters.
+			template <typename _Visitor>
+			size_type scan(size_type cursor, size_type count, _Visitor&& visit) {
+				static_assert(std::is_same_v<GrowthPolicy, power_of_two_growth>,
+					"scan() needs the power_of_two_growth policy");
+				if (length_ == 0) {
+					return 0;
 				}
 
-				iterator some_iter;
-				some_iter.node.dptr_ = data_ + index;
-				some_iter.node.uptr_ = used_ + index;
-				some_iter.node.eptr_ = used_ + capacity_;
-
-				return { some_iter, true };
+				const size_type mask = capacity_ - 1;
+				size_type budget = std::max(static_cast<size_type>(1), count) * 10;
+				size_type visited = 0;
+				do {
+					visited += scan_bucket(cursor & mask, visit);
+					// increments the reversed cursor, counting from the high bits.
+					cursor |= ~mask;
+					cursor = static_cast<size_type>(detail::reverse_bits(cursor));
+					cursor++;
+					cursor = static_cast<size_type>(detail::reverse_bits(cursor));
+				} while (cursor != 0 && visited < count && --budget != 0);
+				return cursor;
 			}
 
-			template <typename... _Args>
-			std::pair<iterator, bool> try_emplace(key_type&& k, _Args&&... args) {
-				size_type index = custom_bucket(k, data_, used_, capacity_);
-				if (index == capacity_ || load_factor() > max_load_factor()) {
-					this->rehash(2 * this->bucket_count());
-					index = custom_bucket(k, data_, used_, capacity_);
-				}
+			// modifiers.
 
-				if (used_[index] != 1) {
-					new (data_ + index) value_type(std::move(k), mapped_type(std::forward<_Args>(args)...)); // todo: maybe forward
-					used_[index] = 1;
-					length_++;
+			///  Looks the key up before constructing anything when the arguments
+			///  are a key and a mapped value or a pair; other argument lists build
+			///  the element first to learn its key.
+			template <typename... _Args>
+			std::pair<iterator, bool> emplace(_Args&&... args) {
+				if constexpr (detail::is_key_value_args<key_type, _Args...>::value) {
+					return emplace_key_value(std::forward<_Args>(args)...);
+				} else if constexpr (detail::is_key_pair_arg<key_type, _Args...>::value) {
+					return emplace_pair(std::forward<_Args>(args)...);
 				} else {
-					return { this->end(), false };
+					return this->insert(value_type(std::forward<_Args>(args)...));
 				}
+			}
 
-				iterator some_iter;
-				some_iter.node.dptr_ = data_ + index;
-				some_iter.node.uptr_ = used_ + index;
-				some_iter.node.eptr_ = used_ + capacity_;
+			template <typename... _Args>
+			std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
+				return emplace_key(k, std::piecewise_construct,
+					std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Args>(args)...));
+			}
 
-				return { some_iter, true };
+			template <typename... _Args>
+			std::pair<iterator, bool> try_emplace(key_type&& k, _Args&&... args) {
+				return emplace_key(k, std::piecewise_construct,
+					std::forward_as_tuple(std::move(k)), std::forward_as_tuple(std::forward<_Args>(args)...));
 			}
 
 			std::pair<iterator, bool> insert(const value_type& x) {
-				size_type index = custom_bucket(x.first, data_, used_, capacity_);
-				if (index == capacity_ || load_factor() > max_load_factor_) {
-					this->rehash(2 * this->bucket_count());
-					index = custom_bucket(x.first, data_, used_, capacity_);
-				}
-
-				if (used_[index] != 1) {
-					new (data_ + index) value_type(x);
-					used_[index] = 1;
-					length_++;
-				} else {
-					return { this->end(), false };
-				}
-
-				iterator some_iter;
-				some_iter.node.dptr_ = data_ + index;
-				some_iter.node.uptr_ = used_ + index;
-				some_iter.node.eptr_ = used_ + capacity_;
-
-				return { some_iter, true };
+				return emplace_key(x.first, x);
 			}
 
 			std::pair<iterator, bool> insert(value_type&& x) {
-				size_type index = custom_bucket(x.first, data_, used_, capacity_);
-				if (index == capacity_ || load_factor() > max_load_factor()) {
-					this->rehash(2 * this->bucket_count());
-					index = custom_bucket(x.first, data_, used_, capacity_);
-				}
-
-				if (used_[index] != 1) {
-					new (data_ + index) value_type(std::move(x)); // todo: maybe forward
-					used_[index] = 1;
-					length_++;
-				} else {
-					return { this->end(), false };
-				}
-
-				iterator some_iter;
-				some_iter.node.dptr_ = data_ + index;
-				some_iter.node.uptr_ = used_ + index;
-				some_iter.node.eptr_ = used_ + capacity_;
-
-				return { some_iter, true };
+				return emplace_key(x.first, std::move(x));
 			}
 
 			template <typename _InputIterator>
@@ -581,78 +1154,63 @@ namespace fefu {
 
 			template <typename _Obj>
 			std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
-				auto iter = this->find(k);
-				bool insert_rtn = false;
-				if (iter == this->end()) {
-					this->insert(value_type(k, obj));
-					insert_rtn = true;
-					iter = this->find(k);
+				check_probe_guard();
+				auto slot = find_or_prepare_insert(k, hasher_(k));
+				if (slot.second) {
+					data_[slot.first].second = std::forward<_Obj>(obj);
 				} else {
-					iter->second = obj;
+					construct_at(slot.first, std::piecewise_construct,
+						std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Obj>(obj)));
 				}
-				return { iter, insert_rtn };
+				return { iterator(node_at(slot.first)), !slot.second };
 			}
 
 			template <typename _Obj>
 			std::pair<iterator, bool> insert_or_assign(key_type&& k, _Obj&& obj) {
-				auto iter = this->find(k);
-				bool insert_rtn = false;
-				if (iter == this->end()) {
-					this->insert(value_type(std::move(k), obj));
-					insert_rtn = true;
-					iter = this->find(k);
+				check_probe_guard();
+				auto slot = find_or_prepare_insert(k, hasher_(k));
+				if (slot.second) {
+					data_[slot.first].second = std::forward<_Obj>(obj);
 				} else {
-					iter->second = obj;
+					construct_at(slot.first, std::piecewise_construct,
+						std::forward_as_tuple(std::move(k)), std::forward_as_tuple(std::forward<_Obj>(obj)));
 				}
-				return { iter, insert_rtn };
+				return { iterator(node_at(slot.first)), !slot.second };
 			}
 
 			iterator erase(const_iterator position) {
-				if (position == this->end() || *position.node.uptr_ != 1) {
+				if (position == this->end() || Metadata::get(used_, position.node.index_) != detail::slot_full) {
 					throw std::runtime_error("Invalid iterator for erase data");
 				}
 
-				*position.node.uptr_ = 2;
 				position.node.dptr_->~value_type();
-				length_--;
-
-				iterator other_position;
-
-				other_position.node.dptr_ = const_cast<value_type *>(position.node.dptr_);
-				other_position.node.eptr_ = position.node.eptr_;
-				other_position.node.uptr_ = position.node.uptr_;
+				vacate(position.node.index_);
 
+				iterator other_position(position.node);
 				other_position++;
 
 				return other_position;
 			}
 
 			iterator erase(iterator position) {
-				if (position == this->end() || *position.node.uptr_ != 1) {
+				if (position == this->end() || Metadata::get(used_, position.node.index_) != detail::slot_full) {
 					throw std::runtime_error("Invalid iterator for erase data");
 				}
 
-				*position.node.uptr_ = 2;
 				position.node.dptr_->~value_type();
+				vacate(position.node.index_);
 				position++;
-				length_--;
 				return position;
 			}
 
+			///  Erases the element with key x. With a non-zero min_load_factor()
+			///  the table shrinks when the load drops below it.
 			size_type erase(const key_type& x) {
-				auto iter = this->find(x);
-				if (iter != this->end()) {
-					this->erase(iter);
-					return 1;
-				}
-				return 0;
+				return erase_hashed(x, hasher_(x));
 			}
 
 			iterator erase(const_iterator first, const_iterator last) {
-				iterator last_iter;
-				last_iter.node.dptr_ = const_cast<value_type*>(last.node.dptr_);
-				last_iter.node.eptr_ = last.node.eptr_;
-				last_iter.node.uptr_ = last.node.uptr_;
+				iterator last_iter(last.node);
 
 				if (first != last) {
 					auto iter = this->erase(first);
@@ -665,47 +1223,135 @@ namespace fefu {
 				return last_iter;
 			}
 
+			///  Destroys the elements, visiting only the occupied slots. With
+			///  generation_metadata and a trivially destructible value_type it is O(1).
 			void clear() noexcept {
-				for (size_type i = 0; i < capacity_; i++) {
-					if (used_[i] == 1) {
+				if constexpr (!std::is_trivially_destructible_v<value_type>) {
+					for (size_type i = first_; i != capacity_; i = Metadata::next_full(used_, i + 1, capacity_)) {
 						data_[i].~value_type();
 					}
-					used_[i] = 0;
+				}
+				if (used_ != nullptr) {
+					if constexpr (detail::has_generations<Metadata>::value) {
+						Metadata::next_generation(used_, capacity_);
+					} else {
+						Metadata::reset(used_, capacity_);
+					}
 				}
 				length_ = 0;
+				first_ = capacity_;
+				guard_length_ = 0;
+				table_generation_++;
 			}
 
 			void swap(hash_map& x) {
-				std::swap(x.data_, data_);
-				std::swap(x.used_, used_);
-				std::swap(x.length_, length_);
-				std::swap(x.capacity_, capacity_);
+				swap_table(x);
 				std::swap(x.allocator_, allocator_);
 				std::swap(x.hasher_, hasher_);
 				std::swap(x.max_load_factor_, max_load_factor_);
 				std::swap(x.pred_, pred_);
+				std::swap(x.stats_, stats_);
+				std::swap(x.min_load_factor_, min_load_factor_);
+				std::swap(x.max_probe_length_, max_probe_length_);
+				std::swap(x.reseed_count_, reseed_count_);
+				std::swap(x.reseed_pending_, reseed_pending_);
 			}
 
-			template <typename _H2, typename _P2>
-			void merge(hash_map<K, T, _H2, _P2, Alloc>& source) {
-				for (auto iter = source.begin(); iter != source.end(); ) {
-					if (!this->contains(iter->first)) {
-						this->insert(*iter);
-						iter = source.erase(iter);
-					} else {
-						iter++;
+			///  Moves every element whose key is not in *this out of source.
+			///  Reserves up front for the larger of the two sizes, so at most one
+			///  more growth step follows; each element is hashed and probed once,
+			///  and its source slot is released without a lookup.
+			///
+			///  A larger source of the same type whose hasher hashes alike (equal
+			///  seeds, or a stateless hasher) already has its elements where this
+			///  map would put them: the two tables are exchanged, so only the
+			///  smaller side is hashed, and shared keys swap their values back.
+			template <typename _H2, typename _P2, typename _M2, typename _S2, typename _G2>
+			void merge(hash_map<K, T, _H2, _P2, Alloc, _M2, _S2, _G2>& source) {
+				if (static_cast<const void*>(&source) == this) {
+					return;
+				}
+
+				bool exchanged = false;
+				if constexpr (std::is_same_v<hash_map, hash_map<K, T, _H2, _P2, Alloc, _M2, _S2, _G2>> && std::is_swappable_v<T>) {
+					if (length_ < source.length_ && detail::same_hashing(hasher_, source.hasher_)) {
+						swap_table(source);
+						exchanged = true;
+					}
+				}
+
+				grow_for(std::max(length_, source.length_));
+				for (size_type i = source.first_; i != source.capacity_; i = _M2::next_full(source.used_, i + 1, source.capacity_)) {
+					check_probe_guard();
+					value_type& x = source.data_[i];
+					auto slot = find_or_prepare_insert(x.first, hasher_(x.first));
+					if (!slot.second) {
+						construct_at(slot.first, x.first, std::move(x.second));
+						source.erase_slot(i);
+					} else if constexpr (std::is_swappable_v<T>) {
+						if (exchanged) {
+							using std::swap;
+							swap(data_[slot.first].second, x.second);
+						}
+					}
+				}
+				if (source.length_ == 0) {
+					source.clear();
+				}
+			}
+
+			template <typename _H2, typename _P2, typename _M2, typename _S2, typename _G2>
+			void merge(hash_map<K, T, _H2, _P2, Alloc, _M2, _S2, _G2>&& source) {
+				this->merge(source);
+			}
+
+			///  Erases every element whose key is not in other (any map with a
+			///  contains()). Returns the number of erased elements.
+			template <typename _Map>
+			size_type intersect_with(const _Map& other) {
+				// the compacting erase would move the slots other is probing.
+				if (static_cast<const void*>(&other) == this) {
+					return 0;
+				}
+				return erase_slots_if([&other](const value_type& x) { return !other.contains(x.first); });
+			}
+
+			///  Erases every element whose key is in other, walking the smaller
+			///  of the two maps. Returns the number of erased elements.
+			template <typename _Map>
+			size_type subtract(const _Map& other) {
+				if (static_cast<const void*>(&other) == this) {
+					size_type erased = length_;
+					this->clear();
+					return erased;
+				}
+				if (other.size() < length_) {
+					size_type erased = 0;
+					for (const auto& x : other) {
+						size_type index = find_index(x.first, hasher_(x.first));
+						if (index != capacity_) {
+							erase_slot(index);
+							erased++;
+						}
 					}
+					shrink_if_sparse();
+					return erased;
 				}
+				return erase_slots_if([&other](const value_type& x) { return other.contains(x.first); });
 			}
 
-			template <typename _H2, typename _P2>
-			void merge(hash_map<K, T, _H2, _P2, Alloc>&& source) {
-				for (auto iter = source.begin(); iter != source.end(); ) {
-					if (!this->contains(iter->first)) {
-						this->insert(std::move(*iter));
-						iter = source.erase(iter);
+			///  Inserts a copy of every element of other; where both maps hold a
+			///  key its value becomes combine(mine, theirs). Reserves like merge().
+			template <typename _Map, typename _Combine>
+			void union_with(const _Map& other, _Combine combine) {
+				grow_for(std::max(length_, static_cast<size_type>(other.size())));
+				for (const auto& x : other) {
+					check_probe_guard();
+					auto slot = find_or_prepare_insert(x.first, hasher_(x.first));
+					if (slot.second) {
+						data_[slot.first].second = combine(data_[slot.first].second, x.second);
 					} else {
-						iter++;
+						construct_at(slot.first, x);
 					}
 				}
 			}
@@ -726,28 +1372,10 @@ namespace fefu {
 
 			// lookup.
 			iterator find(const key_type& x) {
-				size_type index = custom_bucket(x, data_, used_, capacity_);
-				if (index != capacity_ && used_[index] != 1) {
-					index = capacity_;
-				}
-
-				iterator some_iter;
-				some_iter.node.dptr_ = data_ + index;
-				some_iter.node.uptr_ = used_ + index;
-				some_iter.node.eptr_ = used_ + capacity_;
-				return some_iter;
+				return iterator(node_at(find_index(x, hasher_(x))));
 			}
 			const_iterator find(const key_type& x) const {
-				size_type index = custom_bucket(x, data_, used_, capacity_);
-				if (index != capacity_ && used_[index] != 1) {
-					index = capacity_;
-				}
-
-				const_iterator some_iter;
-				some_iter.node.dptr_ = data_ + index;
-				some_iter.node.uptr_ = used_ + index;
-				some_iter.node.eptr_ = used_ + capacity_;
-				return some_iter;
+				return const_iterator(node_at(find_index(x, hasher_(x))));
 			}
 
 			size_type count(const key_type& x) const {
@@ -758,34 +1386,94 @@ namespace fefu {
 				return (this->count(x) == 1);
 			}
 
-			mapped_type& operator[](const key_type& k) {
-				size_type index = custom_bucket(k, data_, used_, capacity_);
-				if (index == capacity_ || load_factor() > max_load_factor()) {
-					this->rehash(2 * this->bucket_count());
-					index = custom_bucket(k, data_, used_, capacity_);
-				}
+			///  Heterogeneous lookup, available when both Hash and Pred define
+			///  is_transparent (e.g. fefu::hash<std::string> with std::equal_to<>).
+			template <typename _Kt, typename _H = Hash,
+				typename = std::enable_if_t<detail::is_transparent_lookup<_H, Pred>::value>>
+			iterator find(const _Kt& x) {
+				return iterator(node_at(find_index(x, hasher_(x))));
+			}
+			template <typename _Kt, typename _H = Hash,
+				typename = std::enable_if_t<detail::is_transparent_lookup<_H, Pred>::value>>
+			const_iterator find(const _Kt& x) const {
+				return const_iterator(node_at(find_index(x, hasher_(x))));
+			}
 
-				if (used_[index] == 0) {
-					new (data_ + index) value_type{ k, mapped_type() };
-					used_[index] = 1;
-					length_++;
-				}
+			template <typename _Kt, typename _H = Hash,
+				typename = std::enable_if_t<detail::is_transparent_lookup<_H, Pred>::value>>
+			size_type count(const _Kt& x) const {
+				return (this->find(x) != this->end() ? 1 : 0);
+			}
 
-				return data_[index].second;
+			template <typename _Kt, typename _H = Hash,
+				typename = std::enable_if_t<detail::is_transparent_lookup<_H, Pred>::value>>
+			bool contains(const _Kt& x) const {
+				return (this->count(x) == 1);
 			}
-			mapped_type& operator[](key_type&& k) {
-				size_type index = custom_bucket(k, data_, used_, capacity_);
-				if (index == capacity_ || load_factor() > max_load_factor()) {
-					this->rehash(2 * this->bucket_count());
-					index = custom_bucket(k, data_, used_, capacity_);
+
+			// precomputed hashes.
+
+			///  Returns the hash the *_hashed members expect for k. A map with an
+			///  equal hasher accepts it too; it goes stale when the probe-length
+			///  guard reseeds the hasher (see reseed_count()).
+			size_t hash_of(const key_type& k) const {
+				return hasher_(k);
+			}
+
+			///  Starts loading the home slot of hash == hash_of(x) and its control
+			///  word into the cache, so a find_hashed(x, hash) issued a little
+			///  later doesn't wait on memory.
+			void prefetch(size_t hash) const noexcept {
+				if (capacity_ == 0) {
+					return;
 				}
+				size_type home = home_index(hash, capacity_, growth_);
+				detail::prefetch(data_ + home);
+				detail::prefetch(used_ + (Metadata::words(home + 1) - 1));
+			}
+
+			///  find(x) with hash == hash_of(x) supplied by the caller.
+			iterator find_hashed(const key_type& x, size_t hash) {
+				return iterator(node_at(find_index(x, hash)));
+			}
+			const_iterator find_hashed(const key_type& x, size_t hash) const {
+				return const_iterator(node_at(find_index(x, hash)));
+			}
+
+			///  try_emplace(k, args...) with hash == hash_of(k).
+			template <typename... _Args>
+			std::pair<iterator, bool> try_emplace_hashed(const key_type& k, size_t hash, _Args&&... args) {
+				auto slot = emplace_slot(k, hash, std::piecewise_construct,
+					std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Args>(args)...));
+				return { iterator(node_at(slot.first)), slot.second };
+			}
 
-				if (used_[index] == 0) {
-					new (data_ + index) value_type{ std::move(k), mapped_type() };
-					used_[index] = 1;
-					length_++;
+			template <typename... _Args>
+			std::pair<iterator, bool> try_emplace_hashed(key_type&& k, size_t hash, _Args&&... args) {
+				auto slot = emplace_slot(k, hash, std::piecewise_construct,
+					std::forward_as_tuple(std::move(k)), std::forward_as_tuple(std::forward<_Args>(args)...));
+				return { iterator(node_at(slot.first)), slot.second };
+			}
+
+			///  erase(x) with hash == hash_of(x).
+			size_type erase_hashed(const key_type& x, size_t hash) {
+				size_type index = find_index(x, hash);
+				if (index == capacity_) {
+					return 0;
 				}
+				erase_slot(index);
+				shrink_if_sparse();
+				return 1;
+			}
 
+			mapped_type& operator[](const key_type& k) {
+				size_type index = emplace_slot(k, hasher_(k), std::piecewise_construct,
+					std::forward_as_tuple(k), std::tuple<>()).first;
+				return data_[index].second;
+			}
+			mapped_type& operator[](key_type&& k) {
+				size_type index = emplace_slot(k, hasher_(k), std::piecewise_construct,
+					std::forward_as_tuple(std::move(k)), std::tuple<>()).first;
 				return data_[index].second;
 			}
 
@@ -794,8 +1482,8 @@ namespace fefu {
 					throw std::out_of_range("Out of range");
 				}
 
-				size_type index = custom_bucket(k, data_, used_, capacity_);
-				if (index == capacity_ || used_[index] == 0) {
+				size_type index = custom_bucket(k, hasher_(k), data_, used_, capacity_, growth_);
+				if (index == capacity_ || Metadata::get(used_, index) != detail::slot_full) {
 					throw std::out_of_range("Out of range");
 				}
 				return data_[index].second;
@@ -805,19 +1493,50 @@ namespace fefu {
 					throw std::out_of_range("Out of range");
 				}
 
-				size_type index = custom_bucket(k, data_, used_, capacity_);
-				if (index == capacity_ || used_[index] == 0) {
+				size_type index = custom_bucket(k, hasher_(k), data_, used_, capacity_, growth_);
+				if (index == capacity_ || Metadata::get(used_, index) != detail::slot_full) {
 					throw std::out_of_range("Out of range");
 				}
 				return data_[index].second;
 			}
 
+			// slot handles.
+
+			///  Handle to the element at position (or to end()) for get().
+			slot_handle handle(const_iterator position) const noexcept {
+				return { position.node.index_, table_generation_ };
+			}
+
+			///  Returns the element handle was taken for without hashing, when
+			///  the table wasn't rebuilt since and the slot still holds k (one key
+			///  comparison). Otherwise falls back to find(k) and points handle at
+			///  the result, so the next get() is fast again.
+			iterator get(slot_handle& handle, const key_type& k) {
+				if (holds(handle, k)) {
+					return iterator(node_at(handle.index));
+				}
+				iterator result = this->find(k);
+				handle = this->handle(result);
+				return result;
+			}
+
+			const_iterator get(const slot_handle& handle, const key_type& k) const {
+				if (holds(handle, k)) {
+					return const_iterator(node_at(handle.index));
+				}
+				return this->find(k);
+			}
+
+			///  Changes whenever elements may have moved (rehash, clear, swap,
+			///  assignment); handles from an older generation are stale.
+			size_type table_generation() const noexcept { return table_generation_; }
+
 			// bucket interface.
 
 			size_type bucket_count() const noexcept { return capacity_; }
 			size_type bucket(const key_type& _K) const {
-				auto idx = custom_bucket(_K, data_, used_, capacity_);
-				if (idx == capacity_ || used_[idx] != 1) {
+				auto idx = custom_bucket(_K, hasher_(_K), data_, used_, capacity_, growth_);
+				if (idx == capacity_ || Metadata::get(used_, idx) != detail::slot_full) {
 					throw std::runtime_error("Out of range");
 				}
 				return idx;
@@ -825,6 +1544,8 @@ namespace fefu {
 
 			// hash policy.
 			float load_factor() const noexcept { return size() * 1.0f / bucket_count(); }
+			///  Load above which an insert grows the table. Copies and moves keep
+			///  it; loads of 0.9 and more save memory at the cost of longer probes.
 			float max_load_factor() const noexcept { return max_load_factor_; }
 			void max_load_factor(float z) { 
 				if (z > 1.0 || z < 0.0) {
@@ -832,20 +1553,58 @@ namespace fefu {
 				}
 				max_load_factor_ = z;
 			}
+			///  Load below which erase(key) shrinks the table; 0 (the default)
+			///  never shrinks. Shrinking targets half of max_load_factor(), so a
+			///  table has to double its size before it grows again.
+			float min_load_factor() const noexcept { return min_load_factor_; }
+			void min_load_factor(float z) {
+				if (z < 0.0 || z >= max_load_factor_ / 2) {
+					throw std::runtime_error("Min Load Factor must be in range [0.0, max_load_factor / 2)");
+				}
+				min_load_factor_ = z;
+			}
+
+			///  Rehashes into the smallest table that holds size() elements
+			///  within max_load_factor(), dropping all deleted slots.
+			void shrink_to_fit() {
+				this->rehash(static_cast<size_type>(ceil(length_ / max_load_factor_)));
+			}
+
+			///  Longest probe an insert into a table loaded to at most half of
+			///  max_load_factor() may take before a reseedable hasher (see
+			///  is_reseedable) is given a new seed and the table rehashed.
+			size_type max_probe_length() const noexcept { return max_probe_length_; }
+			void max_probe_length(size_type n) noexcept { max_probe_length_ = std::max(static_cast<size_type>(1), n); }
+
+			///  Number of reseeds triggered by the probe-length guard.
+			size_type reseed_count() const noexcept { return reseed_count_; }
+
+			///  Rebuilds the table with the bucket count the growth policy picks
+			///  for at least n buckets.
 			void rehash(size_type n) {
-				if (n == 0) n = 1;
+				n = growth_.capacity_for(n);
+				GrowthPolicy n_growth(growth_);
+				n_growth.prepare(n);
 
-				char* n_used = new char[n];
+				std::chrono::steady_clock::time_point started;
+				if constexpr (Stats::enabled) {
+					started = std::chrono::steady_clock::now();
+				}
+
+				word_type* n_used = new word_type[Metadata::words(n)];
 
-				std::fill_n(n_used, n, static_cast<char>(0));
+				Metadata::reset(n_used, n);
 
 				value_type* n_data = allocator_.allocate(n);
+				stats_.on_allocate();
+				size_type n_first = n;
 
 				for (size_type i = 0; i < capacity_; i++) {
-					if (used_[i] == 1) {
-						size_type index = custom_bucket(data_[i].first, n_data, n_used, n);
+					if (Metadata::get(used_, i) == detail::slot_full) {
+						size_type index = custom_bucket(data_[i].first, hasher_(data_[i].first), n_data, n_used, n, n_growth);
 						new (n_data + index) value_type(std::move(data_[i]));
-						n_used[index] = 1;
+						Metadata::set(n_used, index, detail::slot_full);
+						n_first = std::min(n_first, index);
 					}
 				}
 
@@ -858,18 +1617,57 @@ namespace fefu {
 				data_ = n_data;
 
 				capacity_ = n;
+				first_ = n_first;
+				growth_ = n_growth;
+				table_generation_++;
+
+				if constexpr (Stats::enabled) {
+					stats_.on_rehash(std::chrono::steady_clock::now() - started);
+				}
 			}
 			void reserve(size_type n) {
 				this->rehash(ceil(n / max_load_factor()));
 			}
 
+			///  Returns an immutable, densely packed copy of the elements for
+			///  read-mostly use; the map itself is left unchanged.
+			frozen_hash_map<K, T, Hash, Pred> freeze() const {
+				return frozen_hash_map<K, T, Hash, Pred>(this->begin(), this->end(), length_, hasher_, pred_);
+			}
+
+			// statistics.
+
+			///  Returns the counters collected by the Stats policy together with
+			///  the current displacement, tombstone and memory figures.
+			hash_map_stats stats() const {
+				static_assert(Stats::enabled, "stats() requires a collecting Stats policy");
+
+				hash_map_stats result;
+				stats_.fill(result);
+				result.tombstones = Metadata::count(used_, capacity_, detail::slot_deleted);
+				result.metadata_bytes = Metadata::words(capacity_) * sizeof(word_type);
+				result.data_bytes = capacity_ * sizeof(value_type);
+				for (size_type i = first_; i != capacity_; i = Metadata::next_full(used_, i + 1, capacity_)) {
+					size_type home = home_index(hasher_(data_[i].first), capacity_, growth_);
+					size_type displacement = (i + capacity_ - home) % capacity_;
+					result.max_displacement = std::max(result.max_displacement, displacement);
+				}
+				return result;
+			}
+
+			///  Zeroes the counters collected by the Stats policy.
+			void reset_stats() noexcept {
+				stats_ = Stats();
+			}
+
 			bool operator==(const hash_map& other) const {
 				if (length_ != other.length_) {
 					return false;
 				}
 
-				for (auto iter = this->begin(); iter != this->end(); iter++) {
-					if (!other.contains(iter->first) || other.at(iter->first) != iter->second) {
+				for (size_type i = first_; i != capacity_; i = Metadata::next_full(used_, i + 1, capacity_)) {
+					size_type index = other.find_index(data_[i].first, other.hasher_(data_[i].first));
+					if (index == other.capacity_ || !(other.data_[index].second == data_[i].second)) {
 						return false;
 					}
 				}
@@ -877,40 +1675,340 @@ namespace fefu {
 				return true;
 			}
 
+			bool operator!=(const hash_map& other) const {
+				return !(*this == other);
+			}
+
+			///  Erases every element for which pred(element) holds in a single pass
+			///  that also clears all tombstones. Returns the number erased.
+			template <typename _Predicate>
+			friend size_type erase_if(hash_map& map, _Predicate pred) {
+				return map.erase_slots_if(pred);
+			}
+
 		private:
-			size_type custom_bucket(const key_type& _K, value_type* data, char* used, size_type capacity) const {
-				if (capacity == 0) return 0;
+			template <typename, typename, typename, typename, typename, typename, typename, typename>
+			friend class hash_map;
+
+			using word_type = typename Metadata::word_type;
+
+			Node<value_type, Metadata> node_at(size_type index) const noexcept {
+				return Node<value_type, Metadata>(data_ + index, used_, index, capacity_);
+			}
+
+			bool holds(const slot_handle& handle, const key_type& k) const {
+				return handle.generation == table_generation_ && handle.index < capacity_ &&
+					Metadata::get(used_, handle.index) == detail::slot_full && pred_(data_[handle.index].first, k);
+			}
+
+			///  Returns the slot holding x, or capacity_ when x is absent.
+			template <typename _Kt>
+			size_type find_index(const _Kt& x, size_t hash) const {
+				size_type index = custom_bucket(x, hash, data_, used_, capacity_, growth_);
+				if (index != capacity_ && Metadata::get(used_, index) != detail::slot_full) {
+					index = capacity_;
+				}
+				stats_.on_find(index != capacity_);
+				return index;
+			}
+
+			///  Probes once for key. Returns the slot holding it and true, or the
+			///  free slot it belongs in and false. The table grows before the probe,
+			///  so the returned slot stays valid for the insert. Callers run
+			///  check_probe_guard() before hashing, as a reseed changes the hash.
+			template <typename _Kt>
+			std::pair<size_type, bool> find_or_prepare_insert(const _Kt& key, size_t hash) {
+				if (load_factor() > max_load_factor_) {
+					this->rehash(growth_.next_capacity(capacity_));
+				}
+
+				size_type probes = 0;
+				size_type index = custom_bucket(key, hash, data_, used_, capacity_, growth_, &probes);
+				if (index == capacity_) {
+					// no free slot left, which max_load_factor() == 1 allows.
+					this->rehash(growth_.next_capacity(capacity_));
+					index = custom_bucket(key, hash, data_, used_, capacity_, growth_, &probes);
+				}
+
+				if (Metadata::get(used_, index) == detail::slot_full) {
+					return { index, true };
+				}
+				note_probe_length(probes);
+				return { index, false };
+			}
+
+			///  Constructs value_type(args...) in a free slot and marks it full.
+			template <typename... _Args>
+			void construct_at(size_type index, _Args&&... args) {
+				new (data_ + index) value_type(std::forward<_Args>(args)...);
+				occupy(index);
+			}
+
+			///  Constructs value_type(args...) unless key is already present, in
+			///  which case nothing is constructed. Returns the slot and whether
+			///  the element was inserted.
+			template <typename... _Args>
+			std::pair<size_type, bool> emplace_slot(const key_type& key, size_t hash, _Args&&... args) {
+				if (check_probe_guard()) {
+					hash = hasher_(key);
+				}
+				auto slot = find_or_prepare_insert(key, hash);
+				if (slot.second) {
+					return { slot.first, false };
+				}
+				construct_at(slot.first, std::forward<_Args>(args)...);
+				return { slot.first, true };
+			}
+
+			template <typename... _Args>
+			std::pair<iterator, bool> emplace_key(const key_type& key, _Args&&... args) {
+				auto slot = emplace_slot(key, hasher_(key), std::forward<_Args>(args)...);
+				return { iterator(node_at(slot.first)), slot.second };
+			}
+
+			template <typename _Kx, typename _V>
+			std::pair<iterator, bool> emplace_key_value(_Kx&& k, _V&& v) {
+				return emplace_key(k, std::forward<_Kx>(k), std::forward<_V>(v));
+			}
+
+			template <typename _P>
+			std::pair<iterator, bool> emplace_pair(_P&& p) {
+				return emplace_key(p.first, std::forward<_P>(p));
+			}
 
-				size_t first_twos = 0;
-				bool finded_twos = false;
+			///  Exchanges the tables, and the layout state of the growth policy,
+			///  leaving the hashers and the settings in place.
+			void swap_table(hash_map& x) noexcept {
+				std::swap(x.data_, data_);
+				std::swap(x.used_, used_);
+				std::swap(x.length_, length_);
+				std::swap(x.capacity_, capacity_);
+				std::swap(x.first_, first_);
+				std::swap(x.growth_, growth_);
+				std::swap(x.guard_length_, guard_length_);
+				std::swap(x.guard_capacity_, guard_capacity_);
+				x.table_generation_++;
+				table_generation_++;
+			}
+
+			///  Grows the table once so that n elements fit within max_load_factor(),
+			///  stepping through the bucket counts the growth policy would use.
+			void grow_for(size_type n) {
+				size_type capacity = std::max(capacity_, static_cast<size_type>(1));
+				while (n > capacity * max_load_factor_) {
+					capacity = growth_.next_capacity(capacity);
+				}
+				if (capacity != capacity_) {
+					this->rehash(capacity);
+				}
+			}
+
+			void erase_slot(size_type index) {
+				data_[index].~value_type();
+				vacate(index);
+			}
+
+			///  Erases every element matching pred in one pass over the slots and
+			///  leaves no tombstones: the walk starts after an empty slot, which no
+			///  probe sequence crosses, and every survivor that follows a freed slot
+			///  in its cluster moves back to the first free slot from its home.
+			template <typename _Predicate>
+			size_type erase_slots_if(_Predicate&& pred) {
+				size_type erased = 0;
+				size_type start = 0;
+				while (start != capacity_ && Metadata::get(used_, start) != detail::slot_empty) {
+					start++;
+				}
+				if (start == capacity_) {
+					// no empty slot to start from: erase, then rebuild the clusters.
+					for (size_type i = first_; i != capacity_; i = Metadata::next_full(used_, i + 1, capacity_)) {
+						if (pred(static_cast<const_reference>(data_[i]))) {
+							erase_slot(i);
+							erased++;
+						}
+					}
+					this->rehash(capacity_);
+					shrink_if_sparse();
+					return erased;
+				}
+
+				try {
+					bool freed = false;  // a slot of the current cluster was freed
+					size_type i = start;
+					for (size_type n = 1; n < capacity_; n++) {
+						i = (i + 1 == capacity_ ? 0 : i + 1);
+						char state = Metadata::get(used_, i);
+						if (state == detail::slot_empty) {
+							freed = false;
+						} else if (state == detail::slot_deleted) {
+							Metadata::set(used_, i, detail::slot_empty);
+							freed = true;
+						} else if (pred(static_cast<const_reference>(data_[i]))) {
+							data_[i].~value_type();
+							Metadata::set(used_, i, detail::slot_empty);
+							length_--;
+							erased++;
+							freed = true;
+						} else if (freed) {
+							size_type j = home_index(hasher_(data_[i].first), capacity_, growth_);
+							while (j != i && Metadata::get(used_, j) == detail::slot_full) {
+								j = (j + 1 == capacity_ ? 0 : j + 1);
+							}
+							if (j != i) {
+								new (data_ + j) value_type(std::move(data_[i]));
+								data_[i].~value_type();
+								Metadata::set(used_, j, detail::slot_full);
+								Metadata::set(used_, i, detail::slot_empty);
+							}
+						}
+					}
+				} catch (...) {
+					// clusters may be cut short; rebuilding places every survivor again.
+					this->rehash(capacity_);
+					throw;
+				}
+
+				first_ = Metadata::next_full(used_, 0, capacity_);
+				shrink_if_sparse();
+				return erased;
+			}
+
+			void occupy(size_type index) noexcept {
+				Metadata::set(used_, index, detail::slot_full);
+				length_++;
+				if (index < first_) {
+					first_ = index;
+				}
+			}
+
+			///  Flags the table for a reseed when an insert probed further than
+			///  max_probe_length() at no more than half of max_load_factor(), where
+			///  a good hash keeps every probe short; long clusters near the maximum
+			///  load are expected and only grow the table. The guard acts at most
+			///  once per doubling of size(), so its rehashes stay amortized O(1).
+			void note_probe_length(size_type probes) noexcept {
+				if constexpr (is_reseedable_v<Hash>) {
+					if (probes > max_probe_length_ && load_factor() <= max_load_factor_ / 2 && length_ >= 2 * guard_length_) {
+						reseed_pending_ = true;
+					}
+				}
+			}
 
-				size_t start_index = hasher_(_K) % capacity;
-				size_t index = start_index;
-				while (used[index] == 2 || used[index] == 1 && !pred_(data[index].first, _K)) {
-					if (!finded_twos && used[index] == 2) {
-						first_twos = index;
-						finded_twos = true;
+			///  Runs the reseed flagged by note_probe_length before the next insert,
+			///  so iterators and indexes handed out by the flagging insert stay valid.
+			///  When the last reseed was at this bucket count and the probes are
+			///  long again, the keys cluster under any seed and the table grows
+			///  instead. Returns true when it reseeded, so hashes taken before are
+			///  stale.
+			bool check_probe_guard() {
+				if constexpr (is_reseedable_v<Hash>) {
+					if (reseed_pending_) {
+						reseed_pending_ = false;
+						guard_length_ = length_;
+						if (guard_capacity_ == capacity_) {
+							this->rehash(growth_.next_capacity(capacity_));
+							return false;
+						}
+						reseed_count_++;
+						hasher_.reseed(detail::random_seed());
+						this->rehash(capacity_);
+						guard_capacity_ = capacity_;
+						return true;
 					}
+				}
+				return false;
+			}
 
-					index = (index + 1) % capacity;
-					if (index == start_index) {
-						return capacity_;
+			void shrink_if_sparse() {
+				if (min_load_factor_ > 0 && load_factor() < min_load_factor_) {
+					size_type n = growth_.capacity_for(static_cast<size_type>(ceil(length_ / (max_load_factor_ / 2))));
+					if (n < capacity_) {
+						this->rehash(n);
 					}
 				}
-	
-				return (used[index] == 1 || !finded_twos ? index : first_twos);
+			}
+
+			void vacate(size_type index) noexcept {
+				Metadata::set(used_, index, detail::slot_deleted);
+				length_--;
+				if (index == first_) {
+					first_ = Metadata::next_full(used_, index + 1, capacity_);
+				}
+			}
+
+			///  Visits the elements whose home is bucket; they all lie in the run
+			///  of non-empty slots that starts there.
+			template <typename _Visitor>
+			size_type scan_bucket(size_type bucket, _Visitor& visit) {
+				size_type visited = 0;
+				size_type i = bucket;
+				do {
+					char state = Metadata::get(used_, i);
+					if (state == detail::slot_empty) {
+						break;
+					}
+					if (state == detail::slot_full && home_index(hasher_(data_[i].first), capacity_, growth_) == bucket) {
+						visit(data_[i]);
+						visited++;
+					}
+					i = (i + 1 == capacity_ ? 0 : i + 1);
+				} while (i != bucket);
+				return visited;
+			}
+
+			///  Maps a hash to its home slot through the growth policy prepared
+			///  for that capacity.
+			static size_type home_index(size_t hash, size_type capacity, const GrowthPolicy& growth) noexcept {
+				return growth.template index<is_avalanching_v<Hash>>(hash, capacity);
+			}
+
+			template <typename _Kt>
+			size_type custom_bucket(const _Kt& _K, size_t hash, value_type* data, const word_type* used, size_type capacity,
+				const GrowthPolicy& growth, size_type* probe_length = nullptr) const {
+				if (capacity == 0) return 0;
+
+				size_type probes = 0;
+				size_type index = detail::linear_probe(home_index(hash, capacity, growth), capacity,
+					[used](size_type i) { return Metadata::get(used, i); },
+					[&](size_type i) { return pred_(data[i].first, _K); }, probes);
+				if (index == capacity) {
+					return capacity;
+				}
+
+				if constexpr (Stats::enabled) {
+					// rehash placements into the new table are not lookups.
+					if (data == data_) {
+						stats_.on_probe(probes);
+					}
+				}
+				if (probe_length != nullptr) {
+					*probe_length = probes;
+				}
+
+				return index;
 			}
 
 			hasher hasher_;
 			allocator_type allocator_;
 			key_equal pred_;
+			FEFU_NO_UNIQUE_ADDRESS mutable Stats stats_;
+			FEFU_NO_UNIQUE_ADDRESS GrowthPolicy growth_;
 
 			float max_load_factor_;
 
-			char* used_;
+			word_type* used_;
 			value_type* data_;
 			size_type length_;
 			size_type capacity_;
+			size_type first_;  // index of the first full slot, capacity_ if none
+
+			float min_load_factor_ = 0.0f;
+			size_type max_probe_length_ = 64;
+			size_type reseed_count_ = 0;
+			bool reseed_pending_ = false;
+			size_type guard_length_ = 0;    // size() when the guard last acted
+			size_type guard_capacity_ = 0;  // bucket count right after the last reseed
+			size_type table_generation_ = 1;  // bumped whenever elements may move, see slot_handle
 	};
 
 }  // namespace fefu
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define FEFU_HAS_COROUTINES 1
+#endif
+#endif
+
+// Interleaved lookups need C++20 coroutines; with older standards this
+// header declares nothing and FEFU_HAS_COROUTINES stays undefined.
+#if defined(FEFU_HAS_COROUTINES)
+
+namespace fefu {
+
+	/// Awaitable returned by async_find(). Constructing it hashes the key and
+	/// prefetches the home slot; co_await suspends so other lookups run while
+	/// the cache line arrives, and resumes with the result of find().
+	template <typename Map>
+	class find_awaiter {
+	public:
+		using key_type = typename Map::key_type;
+		using size_type = typename Map::size_type;
+
+		find_awaiter(Map& map, const key_type& key)
+			: map_(map), key_(key), hash_(map.hash_of(key)), reseeds_(map.reseed_count()) {
+			map.prefetch(hash_);
+		}
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+		///  Another task may have inserted meanwhile; a reseed makes the hash
+		///  stale, any other change is handled by find_hashed() itself.
+		auto await_resume() const {
+			if (map_.reseed_count() != reseeds_) {
+				return map_.find(key_);
+			}
+			return map_.find_hashed(key_, hash_);
+		}
+
+	private:
+		Map& map_;
+		const key_type& key_;  // lives until the co_await expression ends
+		std::size_t hash_;
+		size_type reseeds_;
+	};
+
+	///  co_await async_find(map, key) in a lookup_task yields map.find(key),
+	///  letting the lookup_scheduler run other tasks while the slot loads.
+	template <typename Map>
+	find_awaiter<Map> async_find(Map& map, const typename Map::key_type& key) {
+		return find_awaiter<Map>(map, key);
+	}
+
+	/// Coroutine run by a lookup_scheduler, typically one request with a
+	/// chain of dependent lookups. It may only co_await async_find(), the
+	/// only suspension the scheduler knows how to resume.
+	class lookup_task {
+		friend class lookup_scheduler;
+	public:
+		struct promise_type {
+			std::exception_ptr error;
+
+			lookup_task get_return_object() noexcept {
+				return lookup_task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			std::suspend_always final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			void unhandled_exception() noexcept { error = std::current_exception(); }
+
+			template <typename Map>
+			find_awaiter<Map> await_transform(find_awaiter<Map> awaiter) const noexcept {
+				return awaiter;
+			}
+		};
+
+		lookup_task(lookup_task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+		lookup_task(const lookup_task&) = delete;
+		lookup_task& operator=(const lookup_task&) = delete;
+		lookup_task& operator=(lookup_task&&) = delete;
+
+		~lookup_task() {
+			if (handle_) {
+				handle_.destroy();
+			}
+		}
+
+	private:
+		explicit lookup_task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	/// Round-robin scheduler for lookup_tasks: each resume runs a task up to
+	/// its next async_find(), whose prefetch then overlaps with the turns of
+	/// all the other tasks. This pays off for chains of dependent lookups
+	/// into tables well beyond the cache, which a plain loop has to wait
+	/// out one miss at a time; independent lookups are overlapped by the
+	/// CPU already and only get slower by the switches. About 16 tasks in
+	/// flight are enough to keep the memory system busy.
+	class lookup_scheduler {
+	public:
+		lookup_scheduler() = default;
+		lookup_scheduler(const lookup_scheduler&) = delete;
+		lookup_scheduler& operator=(const lookup_scheduler&) = delete;
+
+		~lookup_scheduler() {
+			for (auto handle : tasks_) {
+				handle.destroy();
+			}
+		}
+
+		///  Queues task; it starts on the next run().
+		void spawn(lookup_task task) {
+			tasks_.push_back(std::exchange(task.handle_, nullptr));
+		}
+
+		std::size_t size() const noexcept { return tasks_.size(); }
+
+		///  Resumes the queued tasks in turn until all of them have finished.
+		///  An exception escaping a task is rethrown here once the task is
+		///  destroyed; the other tasks stay queued.
+		void run() {
+			std::size_t i = 0;
+			while (!tasks_.empty()) {
+				auto handle = tasks_[i];
+				handle.resume();
+				if (handle.done()) {
+					std::exception_ptr error = handle.promise().error;
+					handle.destroy();
+					tasks_[i] = tasks_.back();
+					tasks_.pop_back();
+					if (error) {
+						std::rethrow_exception(error);
+					}
+				} else {
+					i++;
+				}
+				if (i >= tasks_.size()) {
+					i = 0;
+				}
+			}
+		}
+
+	private:
+		std::vector<std::coroutine_handle<lookup_task::promise_type>> tasks_;
+	};
+
+}  // namespace fefu
+
+#endif  // FEFU_HAS_COROUTINES
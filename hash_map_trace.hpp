@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace fefu {
+
+	/// Operation codes stored in a trace file.
+	enum class trace_op : uint8_t {
+		find = 0,
+		insert = 1,
+		assign = 2,
+		erase = 3,
+		clear = 4
+	};
+
+	/// One traced operation. On disk every record takes 17 bytes:
+	/// the op code followed by the key and the value, little-endian.
+	struct trace_record {
+		static constexpr std::size_t encoded_size = 17;
+
+		trace_op op;
+		uint64_t key;
+		uint64_t value;
+	};
+
+	/// Appends trace records to a binary file.
+	class trace_writer {
+	public:
+		explicit trace_writer(const char* path) : file_(std::fopen(path, "wb")) {
+			if (file_ == nullptr) {
+				throw std::runtime_error("Can't open trace file for writing");
+			}
+		}
+
+		~trace_writer() {
+			std::fclose(file_);
+		}
+
+		trace_writer(const trace_writer&) = delete;
+		trace_writer& operator=(const trace_writer&) = delete;
+
+		void write(const trace_record& r) {
+			unsigned char buf[trace_record::encoded_size];
+			buf[0] = static_cast<unsigned char>(r.op);
+			for (int i = 0; i < 8; i++) {
+				buf[1 + i] = static_cast<unsigned char>(r.key >> (8 * i));
+				buf[9 + i] = static_cast<unsigned char>(r.value >> (8 * i));
+			}
+			if (std::fwrite(buf, sizeof(buf), 1, file_) != 1) {
+				throw std::runtime_error("Can't write trace record");
+			}
+		}
+
+		void flush() { std::fflush(file_); }
+
+	private:
+		std::FILE* file_;
+	};
+
+	/// Reads the records written by trace_writer.
+	class trace_reader {
+	public:
+		explicit trace_reader(const char* path) : file_(std::fopen(path, "rb")) {
+			if (file_ == nullptr) {
+				throw std::runtime_error("Can't open trace file for reading");
+			}
+		}
+
+		~trace_reader() {
+			std::fclose(file_);
+		}
+
+		trace_reader(const trace_reader&) = delete;
+		trace_reader& operator=(const trace_reader&) = delete;
+
+		/// Returns false at the end of the file.
+		bool read(trace_record& r) {
+			unsigned char buf[trace_record::encoded_size];
+			if (std::fread(buf, sizeof(buf), 1, file_) != 1) {
+				return false;
+			}
+
+			r.op = static_cast<trace_op>(buf[0]);
+			r.key = 0;
+			r.value = 0;
+			for (int i = 0; i < 8; i++) {
+				r.key |= static_cast<uint64_t>(buf[1 + i]) << (8 * i);
+				r.value |= static_cast<uint64_t>(buf[9 + i]) << (8 * i);
+			}
+			return true;
+		}
+
+	private:
+		std::FILE* file_;
+	};
+
+	/// Turns a key or a mapped value into the 64-bit number stored in a trace.
+	/// Integers are kept as they are, anything else is replaced by its std::hash,
+	/// which keeps the distinct-key pattern of the workload.
+	struct trace_encoder {
+		template <typename V>
+		uint64_t operator()(const V& v) const {
+			if constexpr (std::is_integral_v<V> || std::is_enum_v<V>) {
+				return static_cast<uint64_t>(v);
+			} else {
+				return static_cast<uint64_t>(std::hash<V>()(v));
+			}
+		}
+	};
+
+	/// Instrumentation hook for a live map: forwards the lookup and update
+	/// calls to the map and appends one trace record per call.
+	template <typename Map, typename Encoder = trace_encoder>
+	class trace_recorder {
+	public:
+		using key_type = typename Map::key_type;
+		using mapped_type = typename Map::mapped_type;
+		using value_type = typename Map::value_type;
+		using iterator = typename Map::iterator;
+
+		trace_recorder(Map& map, trace_writer& writer, Encoder encoder = Encoder())
+			: map_(map), writer_(writer), encoder_(encoder) {
+		}
+
+		iterator find(const key_type& k) {
+			record(trace_op::find, encoder_(k), 0);
+			return map_.find(k);
+		}
+
+		std::pair<iterator, bool> insert(const value_type& x) {
+			record(trace_op::insert, encoder_(x.first), encoder_(x.second));
+			return map_.insert(x);
+		}
+
+		template <typename _Obj>
+		std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
+			record(trace_op::assign, encoder_(k), encoder_(obj));
+			return map_.insert_or_assign(k, std::forward<_Obj>(obj));
+		}
+
+		std::size_t erase(const key_type& k) {
+			record(trace_op::erase, encoder_(k), 0);
+			return map_.erase(k);
+		}
+
+		void clear() {
+			record(trace_op::clear, 0, 0);
+			map_.clear();
+		}
+
+		Map& map() noexcept { return map_; }
+
+	private:
+		void record(trace_op op, uint64_t key, uint64_t value) {
+			writer_.write(trace_record{ op, key, value });
+		}
+
+		Map& map_;
+		trace_writer& writer_;
+		Encoder encoder_;
+	};
+
+}  // namespace fefu
@@ -0,0 +1,199 @@
+// Per-operation latency harness for fefu::hash_map.
+//
+//   g++ -std=c++17 -O2 -march=native latency_bench.cpp -o latency_bench
+//   ./latency_bench synthetic [n]        grow, read and churn a map of n keys
+//   ./latency_bench record <file> [n]    write the synthetic workload as a trace
+//   ./latency_bench replay <file>        replay a trace recorded by trace_recorder
+//
+// Every operation is timed on its own and reported as p50/p99/p99.9/max per
+// operation type, so rehash and tombstone spikes show up in the tail.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "hash_map.hpp"
+#include "hash_map_trace.hpp"
+
+namespace {
+
+	/// Log-linear latency histogram: 16 sub-buckets per power of two of
+	/// nanoseconds, so every value is kept within 6% of its real size.
+	class latency_histogram {
+	public:
+		static constexpr int sub_bits = 4;
+		static constexpr int sub_count = 1 << sub_bits;
+
+		void add(uint64_t ns) {
+			counts_[bucket_of(ns)]++;
+			total_++;
+			max_ = std::max(max_, ns);
+		}
+
+		uint64_t total() const { return total_; }
+		uint64_t max() const { return max_; }
+
+		/// Returns the upper bound of the bucket holding quantile q.
+		uint64_t percentile(double q) const {
+			if (total_ == 0) {
+				return 0;
+			}
+
+			uint64_t rank = static_cast<uint64_t>(q * (total_ - 1)) + 1;
+			uint64_t seen = 0;
+			for (std::size_t i = 0; i < counts_.size(); i++) {
+				seen += counts_[i];
+				if (seen >= rank) {
+					return std::min(upper_bound_of(i), max_);
+				}
+			}
+			return max_;
+		}
+
+	private:
+		static std::size_t bucket_of(uint64_t ns) {
+			if (ns < sub_count) {
+				return static_cast<std::size_t>(ns);
+			}
+			int log = static_cast<int>(fefu::detail::bit_width(ns)) - 1;
+			uint64_t sub = (ns >> (log - sub_bits)) & (sub_count - 1);
+			return static_cast<std::size_t>((log - sub_bits + 1) * sub_count + sub);
+		}
+
+		static uint64_t upper_bound_of(std::size_t bucket) {
+			if (bucket < sub_count) {
+				return bucket;
+			}
+			int log = static_cast<int>(bucket / sub_count) + sub_bits - 1;
+			uint64_t sub = bucket % sub_count;
+			return ((sub_count + sub + 1) << (log - sub_bits)) - 1;
+		}
+
+		std::array<uint64_t, 64 * sub_count> counts_{};
+		uint64_t total_ = 0;
+		uint64_t max_ = 0;
+	};
+
+	const char* op_names[] = { "find", "insert", "assign", "erase", "clear" };
+
+	struct harness {
+		using map_type = fefu::hash_map<uint64_t, uint64_t>;
+
+		map_type map;
+		std::array<latency_histogram, 5> histograms;
+		uint64_t sink = 0;
+
+		void apply(const fefu::trace_record& r) {
+			auto started = std::chrono::steady_clock::now();
+			switch (r.op) {
+			case fefu::trace_op::find:
+				sink += map.find(r.key) != map.end();
+				break;
+			case fefu::trace_op::insert:
+				sink += map.insert({ r.key, r.value }).second;
+				break;
+			case fefu::trace_op::assign:
+				sink += map.insert_or_assign(r.key, r.value).second;
+				break;
+			case fefu::trace_op::erase:
+				sink += map.erase(r.key);
+				break;
+			case fefu::trace_op::clear:
+				map.clear();
+				break;
+			default:
+				throw std::runtime_error("Unknown trace op");
+			}
+			auto elapsed = std::chrono::steady_clock::now() - started;
+			histograms[static_cast<std::size_t>(r.op)].add(
+				static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+		}
+
+		void report() const {
+			std::printf("%-8s %12s %10s %10s %10s %12s\n", "op", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+			for (std::size_t i = 0; i < histograms.size(); i++) {
+				const latency_histogram& h = histograms[i];
+				if (h.total() == 0) {
+					continue;
+				}
+				std::printf("%-8s %12llu %10llu %10llu %10llu %12llu\n", op_names[i],
+					static_cast<unsigned long long>(h.total()),
+					static_cast<unsigned long long>(h.percentile(0.5)),
+					static_cast<unsigned long long>(h.percentile(0.99)),
+					static_cast<unsigned long long>(h.percentile(0.999)),
+					static_cast<unsigned long long>(h.max()));
+			}
+			std::printf("final size %zu, bucket_count %zu\n", map.size(), map.bucket_count());
+		}
+	};
+
+	/// Grows a map to n keys, reads it, then churns it with erase and insert.
+	template <typename Sink>
+	void synthetic_workload(std::size_t n, Sink&& emit) {
+		std::mt19937_64 rng(42);
+		for (std::size_t i = 0; i < n; i++) {
+			emit(fefu::trace_record{ fefu::trace_op::insert, i * 7919, i });
+		}
+		for (std::size_t i = 0; i < n; i++) {
+			emit(fefu::trace_record{ fefu::trace_op::find, (rng() % (2 * n)) * 7919, 0 });
+		}
+		for (std::size_t i = 0; i < n; i++) {
+			emit(fefu::trace_record{ fefu::trace_op::erase, i * 7919, 0 });
+			emit(fefu::trace_record{ fefu::trace_op::assign, (n + i) * 7919, i });
+		}
+	}
+
+	void usage() {
+		std::fprintf(stderr, "usage: latency_bench synthetic [n] | record <file> [n] | replay <file>\n");
+	}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		usage();
+		return 2;
+	}
+
+	std::string mode = argv[1];
+	harness h;
+
+	if (mode == "synthetic") {
+		std::size_t n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+		synthetic_workload(n, [&h](const fefu::trace_record& r) { h.apply(r); });
+	} else if (mode == "record" && argc > 2) {
+		std::size_t n = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000000;
+		fefu::trace_writer writer(argv[2]);
+		fefu::trace_recorder<harness::map_type> recorder(h.map, writer);
+		synthetic_workload(n, [&recorder](const fefu::trace_record& r) {
+			switch (r.op) {
+			case fefu::trace_op::find: recorder.find(r.key); break;
+			case fefu::trace_op::insert: recorder.insert({ r.key, r.value }); break;
+			case fefu::trace_op::assign: recorder.insert_or_assign(r.key, r.value); break;
+			case fefu::trace_op::erase: recorder.erase(r.key); break;
+			case fefu::trace_op::clear: recorder.clear(); break;
+			}
+		});
+		std::printf("recorded %zu keys to %s\n", n, argv[2]);
+		return 0;
+	} else if (mode == "replay" && argc > 2) {
+		fefu::trace_reader reader(argv[2]);
+		fefu::trace_record r;
+		while (reader.read(r)) {
+			h.apply(r);
+		}
+	} else {
+		usage();
+		return 2;
+	}
+
+	h.report();
+	// printed so that the timed operations can't be optimized out.
+	std::printf("# sink %llu\n", static_cast<unsigned long long>(h.sink));
+	return 0;
+}
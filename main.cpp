@@ -2,10 +2,23 @@
 
 #include <catch.hpp>
 #include <climits>
+#include <memory>
+#include <random>
 #include <string>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 #include "hash_map.hpp"
+#include "hash_map_trace.hpp"
+#include "small_hash_map.hpp"
+#include "static_hash_map.hpp"
+#include "perfect_hash_map.hpp"
+#include "dense_hash_map.hpp"
+#include "compact_hash_map.hpp"
+#include "cow_hash_map.hpp"
+#include "hash_map_async.hpp"
+#include "hash_join.hpp"
 
 using namespace std;
 using fefu::hash_map;
@@ -774,4 +787,1516 @@ TEST_CASE("super test allocator", "[allocator]") {
 	for (auto iter = sss.begin(); iter != sss.end(); iter++) {
 		REQUIRE(*iter == idd++);
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("begin skips deleted", "[iterator]") {
+	hash_map<int, int> hm1(100);
+	for (int i = 0; i < 40; i++) {
+		hm1[i] = i;
+	}
+	for (int i = 0; i < 39; i++) {
+		hm1.erase(i);
+	}
+	REQUIRE(hm1.begin()->first == 39);
+	REQUIRE(++hm1.begin() == hm1.end());
+
+	hm1[5] = 5;
+	REQUIRE(hm1.cbegin()->first == 5);
+	hm1.erase(39);
+	hm1.erase(5);
+	REQUIRE(hm1.begin() == hm1.end());
+}
+
+TEST_CASE("iterate sparse table", "[iterator]") {
+	hash_map<int, int> hm1(1000);
+	for (int i = 0; i < 1000; i += 37) {
+		hm1[i] = i * 2;
+	}
+
+	size_t cnt = 0;
+	long long sum = 0;
+	for (auto iter = hm1.cbegin(); iter != hm1.cend(); iter++) {
+		REQUIRE(iter->second == iter->first * 2);
+		sum += iter->first;
+		cnt++;
+	}
+	REQUIRE(cnt == hm1.size());
+
+	long long visited = 0;
+	hm1.for_each_slot([&visited](pair<const int, int>& v) { visited += v.first; v.second++; });
+	REQUIRE(visited == sum);
+	REQUIRE(hm1.at(37) == 75);
+
+	const hash_map<int, int>& chm = hm1;
+	size_t ccnt = 0;
+	chm.for_each_slot([&ccnt](const pair<const int, int>&) { ccnt++; });
+	REQUIRE(ccnt == hm1.size());
+}
+
+TEST_CASE("packed metadata", "[metadata]") {
+	using packed_map = hash_map<int, int, std::hash<int>, std::equal_to<int>,
+		fefu::allocator<pair<const int, int>>, fefu::packed_metadata>;
+
+	packed_map hm1;
+	std::unordered_map<int, int> reference;
+	for (int i = 0; i < 2000; i++) {
+		int key = rand() % 1500;
+		if (i % 3 == 0) {
+			REQUIRE(hm1.erase(key) == reference.erase(key));
+		} else {
+			hm1[key] = i;
+			reference[key] = i;
+		}
+	}
+
+	REQUIRE(hm1.size() == reference.size());
+	size_t cnt = 0;
+	for (auto iter = hm1.begin(); iter != hm1.end(); iter++) {
+		REQUIRE(reference.at(iter->first) == iter->second);
+		cnt++;
+	}
+	REQUIRE(cnt == reference.size());
+
+	packed_map hm2(hm1);
+	REQUIRE(hm2 == hm1);
+	hm2.clear();
+	REQUIRE(hm2.begin() == hm2.end());
+	REQUIRE(hm1.size() == reference.size());
+}
+
+TEST_CASE("packed metadata scan", "[metadata]") {
+	using meta = fefu::packed_metadata;
+	std::vector<meta::word_type> words(meta::words(100));
+	meta::reset(words.data(), 100);
+	REQUIRE(meta::next_full(words.data(), 0, 100) == 100);
+
+	meta::set(words.data(), 31, 1);
+	meta::set(words.data(), 32, 2);
+	meta::set(words.data(), 70, 1);
+	meta::set(words.data(), 99, 1);
+	REQUIRE(meta::get(words.data(), 32) == 2);
+	REQUIRE(meta::next_full(words.data(), 0, 100) == 31);
+	REQUIRE(meta::next_full(words.data(), 32, 100) == 70);
+	REQUIRE(meta::next_full(words.data(), 71, 100) == 99);
+	REQUIRE(meta::next_full(words.data(), 100, 100) == 100);
+	REQUIRE(meta::count(words.data(), 100, 1) == 3);
+	REQUIRE(meta::count(words.data(), 100, 2) == 1);
+	REQUIRE(meta::count(words.data(), 100, 0) == 96);
+}
+
+TEST_CASE("stats", "[stats]") {
+	using stats_map = hash_map<int, int, std::hash<int>, std::equal_to<int>,
+		fefu::allocator<pair<const int, int>>, fefu::byte_metadata, fefu::collect_stats>;
+
+	stats_map hm1(10);
+	hm1[0] = 0;
+	hm1[10] = 10;
+	hm1[20] = 20;
+	hm1.erase(10);
+
+	REQUIRE(hm1.find(20) != hm1.end());
+	REQUIRE(hm1.find(30) == hm1.end());
+
+	fefu::hash_map_stats st = hm1.stats();
+	REQUIRE(st.find_hits == 2);
+	REQUIRE(st.find_misses == 1);
+	REQUIRE(st.tombstones == 1);
+	REQUIRE(st.max_displacement == 2);
+	REQUIRE(st.rehash_count == 0);
+	REQUIRE(st.realloc_count == 1);
+	REQUIRE(st.metadata_bytes == 10);
+	REQUIRE(st.data_bytes == 10 * sizeof(pair<const int, int>));
+	REQUIRE(st.probe_histogram[0] > 0);
+	REQUIRE(st.probe_histogram[2] > 0);
+
+	hm1.rehash(64);
+	st = hm1.stats();
+	REQUIRE(st.rehash_count == 1);
+	REQUIRE(st.realloc_count == 2);
+	REQUIRE(st.tombstones == 0);
+	REQUIRE(st.max_displacement == 0);
+
+	hm1.reset_stats();
+	REQUIRE(hm1.stats().find_hits == 0);
+	REQUIRE(sizeof(hash_map<int, int>) < sizeof(stats_map));
+}
+
+TEST_CASE("trace record and replay", "[trace]") {
+	const char* path = "trace_test.bin";
+	hash_map<uint64_t, uint64_t> hm1;
+	{
+		fefu::trace_writer writer(path);
+		fefu::trace_recorder<hash_map<uint64_t, uint64_t>> recorder(hm1, writer);
+		recorder.insert({ 1, 10 });
+		recorder.insert_or_assign(2, 20);
+		REQUIRE(recorder.find(1) != hm1.end());
+		REQUIRE(recorder.erase(1) == 1);
+		recorder.clear();
+	}
+	REQUIRE(hm1.empty());
+
+	fefu::trace_reader reader(path);
+	fefu::trace_record r;
+	vector<pair<int, uint64_t>> ops;
+	while (reader.read(r)) {
+		ops.emplace_back(static_cast<int>(r.op), r.key + r.value);
+	}
+	std::remove(path);
+
+	REQUIRE(ops.size() == 5);
+	REQUIRE(ops[0] == make_pair(static_cast<int>(fefu::trace_op::insert), uint64_t(11)));
+	REQUIRE(ops[1] == make_pair(static_cast<int>(fefu::trace_op::assign), uint64_t(22)));
+	REQUIRE(ops[2] == make_pair(static_cast<int>(fefu::trace_op::find), uint64_t(1)));
+	REQUIRE(ops[3] == make_pair(static_cast<int>(fefu::trace_op::erase), uint64_t(1)));
+	REQUIRE(ops[4] == make_pair(static_cast<int>(fefu::trace_op::clear), uint64_t(0)));
+}
+
+TEST_CASE("fefu hash", "[hash]") {
+	REQUIRE(fefu::is_avalanching_v<fefu::hash<int>>);
+	REQUIRE(fefu::is_avalanching_v<fefu::hash<std::string>>);
+	REQUIRE(!fefu::is_avalanching_v<std::hash<int>>);
+
+	fefu::hash<uint64_t> int_hash;
+	REQUIRE(int_hash(1) != int_hash(2));
+	REQUIRE((int_hash(1) & 0xFFFF) != (int_hash(1 << 16) & 0xFFFF));
+
+	fefu::hash<std::string> str_hash;
+	std::string long_key(100, 'x');
+	REQUIRE(str_hash(std::string("abc")) == str_hash(std::string_view("abc")));
+	REQUIRE(str_hash("abc") == str_hash(std::string("abc")));
+	REQUIRE(str_hash(long_key) != str_hash(long_key.substr(1)));
+	REQUIRE(str_hash("") != str_hash("a"));
+
+	fefu::hash<std::pair<int, int>> pair_hash;
+	REQUIRE(pair_hash({ 1, 2 }) != pair_hash({ 2, 1 }));
+	fefu::hash<std::tuple<int, std::string>> tuple_hash;
+	REQUIRE(tuple_hash({ 1, "a" }) != tuple_hash({ 1, "b" }));
+}
+
+TEST_CASE("fefu hash in hash_map", "[hash]") {
+	hash_map<std::string, int, fefu::hash<std::string>, std::equal_to<>> hm1;
+	for (int i = 0; i < 1000; i++) {
+		hm1[std::to_string(i)] = i;
+	}
+	REQUIRE(hm1.find(std::string_view("777"))->second == 777);
+	REQUIRE(hm1.find("12") != hm1.end());
+	REQUIRE(hm1.contains(std::string_view("999")));
+	REQUIRE(hm1.count("1000") == 0);
+
+	hash_map<uint64_t, int> strided(1024);
+	for (uint64_t i = 0; i < 400; i++) {
+		strided[i << 12] = static_cast<int>(i);
+	}
+	for (uint64_t i = 0; i < 400; i++) {
+		REQUIRE(strided.at(i << 12) == static_cast<int>(i));
+	}
+}
+
+TEST_CASE("seeded hash", "[hash]") {
+	fefu::seeded_hash<std::string> h1;
+	fefu::seeded_hash<std::string> h2;
+	REQUIRE(h1 != h2);
+	REQUIRE(h1("abc") != h2("abc"));
+	h2.reseed(h1.seed());
+	REQUIRE(h1("abc") == h2(std::string_view("abc")));
+	REQUIRE(fefu::is_reseedable_v<fefu::seeded_hash<int>>);
+	REQUIRE(!fefu::is_reseedable_v<fefu::hash<int>>);
+
+	fefu::seeded_hash<int> i1(1);
+	fefu::seeded_hash<int> i2(2);
+	REQUIRE(i1(5) != i2(5));
+}
+
+// Collides every key until it is reseeded, like a key set crafted against a known seed.
+struct colliding_hash {
+	uint64_t seed = 0;
+
+	size_t operator()(int k) const {
+		return seed == 0 ? 0 : fefu::seeded_hash<int>(seed)(k);
+	}
+	void reseed(uint64_t s) { seed = s | 1; }
+};
+
+TEST_CASE("probe length guard", "[hash]") {
+	hash_map<int, int, colliding_hash> hm1(1024);
+	hm1.max_probe_length(32);
+	for (int i = 0; i < 300; i++) {
+		hm1[i] = i;
+	}
+
+	REQUIRE(hm1.reseed_count() == 1);
+	REQUIRE(hm1.hash_function().seed != 0);
+	REQUIRE(hm1.size() == 300);
+	for (int i = 0; i < 300; i++) {
+		REQUIRE(hm1.at(i) == i);
+	}
+
+	hash_map<int, int, fefu::seeded_hash<int>> hm2;
+	for (int i = 0; i < 10000; i++) {
+		hm2[i] = i;
+	}
+	REQUIRE(hm2.reseed_count() == 0);
+}
+
+struct unseedable_hash {
+	size_t operator()(int) const { return 0; }
+	void reseed(uint64_t) {}
+};
+
+TEST_CASE("probe length guard at high load", "[hash]") {
+	// long clusters near max_load_factor() grow the table, they don't reseed it.
+	hash_map<uint64_t, uint64_t, fefu::seeded_hash<uint64_t>> hm1;
+	hm1.max_load_factor(0.9f);
+	for (uint64_t i = 0; i < 200000; i++) {
+		hm1[i * 7919] = i;
+	}
+	REQUIRE(hm1.reseed_count() <= 1);
+	REQUIRE(hm1.size() == 200000);
+
+	// a hash no seed can fix gets one reseed and growth, once per doubling.
+	hash_map<int, int, unseedable_hash> hm2(1024);
+	hm2.max_probe_length(32);
+	for (int i = 0; i < 2000; i++) {
+		hm2[i] = i;
+	}
+	REQUIRE(hm2.reseed_count() <= 3);
+	REQUIRE(hm2.bucket_count() <= 16384);
+	for (int i = 0; i < 2000; i++) {
+		REQUIRE(hm2.at(i) == i);
+	}
+}
+
+TEST_CASE("copy assigment keeps the seed", "[assigment]") {
+	hash_map<int, int, fefu::seeded_hash<int>> hm1;
+	for (int i = 0; i < 100; i++) {
+		hm1[i] = i;
+	}
+	hash_map<int, int, fefu::seeded_hash<int>> hm2;
+	hm2[-1] = -1;
+	hm2 = hm1;
+	REQUIRE(hm2.size() == 100);
+	REQUIRE(hm2.hash_function() == hm1.hash_function());
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(hm2.at(i) == i);
+	}
+
+	hash_map<int, int, colliding_hash> hm3(1024);
+	hm3.max_probe_length(32);
+	for (int i = 0; i < 300; i++) {
+		hm3[i] = i;
+	}
+	hash_map<int, int, colliding_hash> hm4;
+	hm4 = hm3;
+	REQUIRE(hm4.reseed_count() == 1);
+	for (int i = 0; i < 300; i++) {
+		REQUIRE(hm4.at(i) == i);
+	}
+
+	auto& self = hm1;
+	hm1 = self;
+	REQUIRE(hm1.size() == 100);
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(hm1.at(i) == i);
+	}
+}
+
+TEST_CASE("shrink_to_fit", "[rehash]") {
+	hash_map<int, int> hm1;
+	for (int i = 0; i < 10000; i++) {
+		hm1[i] = i;
+	}
+	for (int i = 10; i < 10000; i++) {
+		hm1.erase(i);
+	}
+	REQUIRE(hm1.bucket_count() >= 10000);
+
+	hm1.shrink_to_fit();
+	REQUIRE(hm1.bucket_count() == 23);
+	REQUIRE(hm1.size() == 10);
+	for (int i = 0; i < 10; i++) {
+		REQUIRE(hm1.at(i) == i);
+	}
+
+	hm1.clear();
+	hm1.shrink_to_fit();
+	REQUIRE(hm1.bucket_count() == 1);
+	REQUIRE(hm1.begin() == hm1.end());
+}
+
+TEST_CASE("min load factor", "[rehash]") {
+	hash_map<int, int> hm1;
+	CHECK_THROWS(hm1.min_load_factor(0.3f));
+	CHECK_THROWS(hm1.min_load_factor(-1.0f));
+	hm1.min_load_factor(0.1f);
+
+	for (int i = 0; i < 10000; i++) {
+		hm1[i] = i;
+	}
+	size_t peak = hm1.bucket_count();
+	for (int i = 0; i < 9990; i++) {
+		hm1.erase(i);
+		REQUIRE(hm1.load_factor() <= hm1.max_load_factor());
+	}
+	REQUIRE(hm1.bucket_count() < peak / 100);
+	REQUIRE(hm1.load_factor() >= 0.1f);
+	for (int i = 9990; i < 10000; i++) {
+		REQUIRE(hm1.at(i) == i);
+	}
+
+	hash_map<int, int> hm2(hm1);
+	REQUIRE(abs(hm2.min_load_factor() - 0.1f) < EPS);
+}
+
+template <typename Growth>
+using growth_map = hash_map<int, int, std::hash<int>, std::equal_to<int>,
+	fefu::allocator<pair<const int, int>>, fefu::byte_metadata, fefu::no_stats, Growth>;
+
+TEST_CASE("growth policy", "[rehash]") {
+	growth_map<fefu::power_of_two_growth> hm1(100);
+	REQUIRE(hm1.bucket_count() == 128);
+
+	growth_map<fefu::one_and_half_growth> hm2;
+	std::vector<size_t> counts = { hm2.bucket_count() };
+	growth_map<fefu::prime_growth> hm3(100);
+	REQUIRE(hm3.bucket_count() == 131);
+	hm3.max_load_factor(0.9f);
+
+	for (int i = 0; i < 10000; i++) {
+		hm1[i * 4096] = i;
+		hm2[i] = i;
+		if (hm2.bucket_count() != counts.back()) {
+			counts.push_back(hm2.bucket_count());
+		}
+		hm3[i * 4096] = i;
+	}
+	REQUIRE((hm1.bucket_count() & (hm1.bucket_count() - 1)) == 0);
+	REQUIRE((std::vector<size_t>(counts.begin(), counts.begin() + 6) == std::vector<size_t>{ 1, 2, 3, 4, 6, 9 }));
+	REQUIRE(hm3.bucket_count() == 16411);
+	for (int i = 0; i < 10000; i++) {
+		REQUIRE(hm1.at(i * 4096) == i);
+		REQUIRE(hm2.at(i) == i);
+		REQUIRE(hm3.at(i * 4096) == i);
+	}
+
+	hm3.reserve(100000);
+	REQUIRE(hm3.bucket_count() == 131101);
+	REQUIRE(hm3.at(4096) == 1);
+}
+
+TEST_CASE("prime growth fastmod", "[rehash]") {
+	std::mt19937_64 rng(7);
+	const uint64_t* primes = fefu::prime_growth::primes();
+	for (size_t i = 0; i < fefu::prime_growth::prime_count; i++) {
+		fefu::prime_growth growth;
+		growth.prepare(primes[i]);
+		for (int j = 0; j < 1000; j++) {
+			uint64_t h = rng() >> (j % 64);
+			REQUIRE(growth.index<false>(h, primes[i]) == h % primes[i]);
+		}
+		REQUIRE(growth.index<false>(~0ull, primes[i]) == ~0ull % primes[i]);
+	}
+}
+
+TEST_CASE("max load factor is kept", "[max_load_factor]") {
+	hash_map<int, int> hm1;
+	hm1.max_load_factor(0.95f);
+	for (int i = 0; i < 1000; i++) {
+		hm1[i] = i;
+	}
+	REQUIRE(hm1.load_factor() > 0.45f);
+
+	hash_map<int, int> hm2(hm1);
+	REQUIRE(abs(hm2.max_load_factor() - 0.95f) < EPS);
+	hash_map<int, int> hm3;
+	hm3 = hm1;
+	REQUIRE(abs(hm3.max_load_factor() - 0.95f) < EPS);
+	hash_map<int, int> hm4(std::move(hm3));
+	REQUIRE(abs(hm4.max_load_factor() - 0.95f) < EPS);
+	hash_map<int, int> hm5;
+	hm5 = std::move(hm4);
+	REQUIRE(abs(hm5.max_load_factor() - 0.95f) < EPS);
+	REQUIRE(hm5 == hm1);
+}
+
+struct counted {
+	static int constructed;
+
+	int value;
+
+	counted(int v) : value(v) { constructed++; }
+	counted(const counted& other) : value(other.value) { constructed++; }
+	counted(counted&& other) noexcept : value(other.value) { constructed++; }
+	counted& operator=(const counted&) = default;
+};
+int counted::constructed = 0;
+
+TEST_CASE("emplace constructs once", "[emplace]") {
+	hash_map<int, counted> hm1;
+	hm1.reserve(100);
+
+	counted::constructed = 0;
+	auto res = hm1.try_emplace(1, 10);
+	REQUIRE(res.second);
+	REQUIRE(res.first->second.value == 10);
+	REQUIRE(counted::constructed == 1);
+
+	res = hm1.try_emplace(1, 20);
+	REQUIRE(!res.second);
+	REQUIRE(res.first->second.value == 10);
+	REQUIRE(counted::constructed == 1);
+
+	counted c(30);
+	pair<int, counted> p(1, c);
+	counted::constructed = 0;
+	REQUIRE(!hm1.emplace(1, c).second);
+	REQUIRE(!hm1.emplace(std::move(p)).second);
+	REQUIRE(counted::constructed == 0);
+	REQUIRE(hm1.emplace(2, c).second);
+	REQUIRE(counted::constructed == 1);
+
+	REQUIRE(!hm1.insert_or_assign(2, c).second);
+	REQUIRE(counted::constructed == 1);
+	REQUIRE(hm1.insert_or_assign(3, c).second);
+	REQUIRE(counted::constructed == 2);
+	REQUIRE(hm1.at(3).value == 30);
+}
+
+TEST_CASE("insert probes once", "[emplace]") {
+	hash_map<int, int, std::hash<int>, std::equal_to<int>, fefu::allocator<pair<const int, int>>,
+		fefu::byte_metadata, fefu::collect_stats> hm1(1000);
+	auto probes = [&hm1] {
+		size_t total = 0;
+		for (size_t n : hm1.stats().probe_histogram) {
+			total += n;
+		}
+		return total;
+	};
+
+	hm1.insert_or_assign(1, 1);
+	REQUIRE(probes() == 1);
+	hm1.insert_or_assign(1, 2);
+	hm1.try_emplace(2, 2);
+	hm1.emplace(3, 3);
+	hm1.insert({ 4, 4 });
+	hm1[5] = 5;
+	REQUIRE(probes() == 6);
+	REQUIRE(hm1.at(1) == 2);
+}
+
+TEST_CASE("move-only values", "[emplace]") {
+	hash_map<int, std::unique_ptr<int>> hm1;
+	for (int i = 0; i < 100; i++) {
+		hm1.try_emplace(4 * i, new int(i));
+		hm1.emplace(4 * i + 1, std::make_unique<int>(i));
+		hm1[4 * i + 2] = std::make_unique<int>(i);
+		hm1.insert_or_assign(4 * i + 3, std::make_unique<int>(i));
+	}
+	REQUIRE(hm1.size() == 400);
+	for (int i = 0; i < 400; i++) {
+		REQUIRE(*hm1.at(i) == i / 4);
+	}
+
+	std::unique_ptr<int> p(new int(7));
+	REQUIRE(!hm1.try_emplace(0, std::move(p)).second);
+	REQUIRE(p != nullptr);
+}
+
+struct counting_string_hash {
+	static int calls;
+
+	size_t operator()(const string& s) const {
+		calls++;
+		return fefu::hash<string>()(s);
+	}
+};
+int counting_string_hash::calls = 0;
+
+TEST_CASE("precomputed hash", "[hashed]") {
+	hash_map<string, int, counting_string_hash> hm1(64), hm2(64);
+	std::vector<string> keys;
+	for (int i = 0; i < 20; i++) {
+		keys.push_back("key" + std::to_string(i));
+	}
+
+	counting_string_hash::calls = 0;
+	std::vector<size_t> hashes;
+	for (int i = 0; i < 20; i++) {
+		hashes.push_back(hm1.hash_of(keys[i]));
+		REQUIRE(hm1.try_emplace_hashed(keys[i], hashes[i], i).second);
+		REQUIRE(hm2.try_emplace_hashed(keys[i], hashes[i], -i).second);
+	}
+	REQUIRE(!hm1.try_emplace_hashed(keys[0], hashes[0], 100).second);
+	for (int i = 0; i < 20; i++) {
+		REQUIRE(hm1.find_hashed(keys[i], hashes[i])->second == i);
+		REQUIRE(hm2.find_hashed(keys[i], hashes[i])->second == -i);
+	}
+	REQUIRE(hm1.find_hashed("missing", hm1.hash_of("missing")) == hm1.end());
+	REQUIRE(hm1.erase_hashed(keys[3], hashes[3]) == 1);
+	REQUIRE(hm1.erase_hashed(keys[3], hashes[3]) == 0);
+	REQUIRE(counting_string_hash::calls == 20 + 1);
+
+	REQUIRE(hm1.size() == 19);
+	REQUIRE(!hm1.contains(keys[3]));
+	REQUIRE(hm1.at(keys[4]) == 4);
+	REQUIRE(hm1.hash_of(keys[5]) == hm1.hash_function()(keys[5]));
+}
+
+TEST_CASE("merge moves values", "[merge]") {
+	hash_map<int, std::unique_ptr<int>> hm1;
+	hash_map<int, std::unique_ptr<int>, fefu::hash<int>> hm2;
+	for (int i = 0; i < 1000; i++) {
+		hm1.try_emplace(i, new int(i));
+		hm2.try_emplace(i + 500, new int(-i));
+	}
+
+	hm1.merge(hm2);
+	REQUIRE(hm1.size() == 1500);
+	REQUIRE(hm2.size() == 500);
+	for (int i = 0; i < 1500; i++) {
+		REQUIRE(*hm1.at(i) == (i < 1000 ? i : 500 - i));
+	}
+	for (int i = 500; i < 1000; i++) {
+		REQUIRE(*hm2.at(i) == 500 - i);
+	}
+
+	hash_map<int, std::unique_ptr<int>> hm3;
+	hm3.merge(std::move(hm1));
+	REQUIRE(hm3.size() == 1500);
+	REQUIRE(hm1.size() == 0);
+	REQUIRE(hm1.begin() == hm1.end());
+}
+
+TEST_CASE("merge takes over a larger table", "[merge]") {
+	hash_map<string, int, counting_string_hash> hm1, hm2;
+	for (int i = 0; i < 100; i++) {
+		hm1[std::to_string(i)] = i;
+	}
+	for (int i = 50; i < 1000; i++) {
+		hm2[std::to_string(i)] = -i;
+	}
+
+	// only the smaller side is hashed, against the table it gets from hm2.
+	counting_string_hash::calls = 0;
+	hm1.merge(hm2);
+	REQUIRE(counting_string_hash::calls == 100);
+	REQUIRE(hm1.size() == 1000);
+	REQUIRE(hm2.size() == 50);
+	for (int i = 0; i < 1000; i++) {
+		REQUIRE(hm1.at(std::to_string(i)) == (i < 100 ? i : -i));
+	}
+	for (int i = 50; i < 100; i++) {
+		REQUIRE(hm2.at(std::to_string(i)) == -i);
+	}
+
+	// seeded hashers only when the seeds match.
+	hash_map<int, int, fefu::seeded_hash<int>> hm3;
+	for (int i = 0; i < 1000; i++) {
+		hm3[i] = -i;
+	}
+	hash_map<int, int, fefu::seeded_hash<int>> hm4(16, hm3.hash_function()), hm5;
+	hm4[0] = 0;
+	hm5[1] = 1;
+	auto hm6 = hm3;
+	hm4.merge(hm3);
+	hm5.merge(hm6);
+	REQUIRE(hm4.size() == 1000);
+	REQUIRE(hm5.size() == 1000);
+	REQUIRE(hm3.size() == 1);
+	REQUIRE(hm6.size() == 1);
+	for (int i = 1; i < 1000; i++) {
+		REQUIRE(hm4.at(i) == -i);
+		REQUIRE(hm5.at(i) == (i == 1 ? 1 : -i));
+	}
+	REQUIRE(hm3.at(0) == 0);
+	REQUIRE(hm6.at(1) == -1);
+}
+
+TEST_CASE("set algebra", "[merge]") {
+	hash_map<int, int> hm1, hm2;
+	for (int i = 0; i < 100; i++) {
+		hm1[i] = i;
+	}
+	for (int i = 50; i < 150; i++) {
+		hm2[i] = 1;
+	}
+
+	hash_map<int, int> both(hm1);
+	REQUIRE(both.intersect_with(hm2) == 50);
+	REQUIRE(both.size() == 50);
+	for (int i = 50; i < 100; i++) {
+		REQUIRE(both.at(i) == i);
+	}
+
+	hash_map<int, int> left(hm1);
+	REQUIRE(left.subtract(hm2) == 50);
+	REQUIRE(left.size() == 50);
+	REQUIRE(!left.contains(50));
+	REQUIRE(left.at(49) == 49);
+
+	hash_map<int, int> small = { { 3, 0 }, { 7, 0 }, { 1000, 0 } };
+	hash_map<int, int> rest(hm1);
+	REQUIRE(rest.subtract(small) == 2);
+	REQUIRE(rest.size() == 98);
+	REQUIRE(!rest.contains(7));
+
+	hash_map<int, int> all(hm1);
+	all.union_with(hm2, std::plus<int>());
+	REQUIRE(all.size() == 150);
+	REQUIRE(all.at(10) == 10);
+	REQUIRE(all.at(60) == 61);
+	REQUIRE(all.at(120) == 1);
+
+	std::unordered_map<int, int> std_map = { { 1, 5 }, { 500, 5 } };
+	all.union_with(std_map, [](int mine, int theirs) { return mine * theirs; });
+	REQUIRE(all.at(1) == 5);
+	REQUIRE(all.at(500) == 5);
+}
+
+TEST_CASE("set algebra with itself", "[merge]") {
+	hash_map<int, int> hm1;
+	for (int i = 0; i < 666; i++) {
+		hm1[i * 7] = i;
+	}
+	REQUIRE(hm1.intersect_with(hm1) == 0);
+	REQUIRE(hm1.size() == 666);
+	for (int i = 0; i < 666; i++) {
+		REQUIRE(hm1.at(i * 7) == i);
+	}
+
+	REQUIRE(hm1.subtract(hm1) == 666);
+	REQUIRE(hm1.empty());
+	REQUIRE(hm1.begin() == hm1.end());
+}
+
+TEST_CASE("equals probes once", "[equals]") {
+	hash_map<int, string> hm1, hm2(1000);
+	for (int i = 0; i < 200; i++) {
+		hm1[i] = std::to_string(i);
+		hm2[199 - i] = std::to_string(199 - i);
+	}
+	REQUIRE(hm1 == hm2);
+	REQUIRE(!(hm1 != hm2));
+
+	hm2[5] = "five";
+	REQUIRE(hm1 != hm2);
+	hm2.erase(5);
+	hm2[200] = "5";
+	REQUIRE(hm1 != hm2);
+}
+
+struct constant_hash {
+	size_t operator()(int) const { return 7; }
+};
+
+TEST_CASE("erase_if", "[erase]") {
+	hash_map<int, int, std::hash<int>, std::equal_to<int>, fefu::allocator<pair<const int, int>>,
+		fefu::byte_metadata, fefu::collect_stats> hm1;
+	for (int i = 0; i < 10000; i++) {
+		hm1[i] = i;
+	}
+	for (int i = 0; i < 10000; i += 7) {
+		hm1.erase(i);
+	}
+	REQUIRE(hm1.stats().tombstones > 0);
+
+	REQUIRE(erase_if(hm1, [](const pair<const int, int>& x) { return x.first % 10 < 3; }) == 2571);
+	REQUIRE(hm1.stats().tombstones == 0);
+	REQUIRE(hm1.size() == 10000 - 1429 - 2571);
+	for (int i = 0; i < 10000; i++) {
+		REQUIRE(hm1.contains(i) == (i % 7 != 0 && i % 10 >= 3));
+	}
+	REQUIRE(hm1.begin()->first % 10 >= 3);
+}
+
+TEST_CASE("erase_if rebuilds clusters", "[erase]") {
+	hash_map<int, int, constant_hash, std::equal_to<int>, fefu::allocator<pair<const int, int>>,
+		fefu::packed_metadata> hm1(100);
+	for (int i = 0; i < 20; i++) {
+		hm1[i] = i;
+	}
+	REQUIRE(erase_if(hm1, [](const pair<const int, int>& x) { return x.first % 3 == 0; }) == 7);
+	REQUIRE(hm1.size() == 13);
+	for (int i = 0; i < 20; i++) {
+		REQUIRE(hm1.contains(i) == (i % 3 != 0));
+	}
+	for (int i = 1; i < 20; i += 3) {
+		REQUIRE((hm1.bucket(i) >= 7 && hm1.bucket(i) < 20));
+	}
+
+	// a full table has no empty slot to start from.
+	hash_map<int, int> hm2(4);
+	hm2.max_load_factor(1.0f);
+	for (int i = 0; i < 4; i++) {
+		hm2[i] = i;
+	}
+	REQUIRE(hm2.bucket_count() == 4);
+	REQUIRE(erase_if(hm2, [](const pair<const int, int>& x) { return x.first == 2; }) == 1);
+	REQUIRE((hm2.size() == 3 && hm2.contains(3) && !hm2.contains(2)));
+
+	hash_map<int, int, constant_hash> hm3(64);
+	for (int i = 0; i < 20; i++) {
+		hm3[i] = i;
+	}
+	int calls = 0;
+	CHECK_THROWS(erase_if(hm3, [&calls](const pair<const int, int>& x) {
+		if (++calls == 10) {
+			throw std::runtime_error("stop");
+		}
+		return x.first % 2 == 0;
+	}));
+	size_t found = 0;
+	for (int i = 0; i < 20; i++) {
+		REQUIRE((i % 2 == 0 || hm3.contains(i)));
+		found += hm3.count(i);
+	}
+	REQUIRE(found == hm3.size());
+	REQUIRE(hm3.size() < 20);
+}
+
+template <typename V>
+using generation_map = hash_map<int, V, std::hash<int>, std::equal_to<int>,
+	fefu::allocator<pair<const int, V>>, fefu::generation_metadata>;
+
+TEST_CASE("generation clear", "[clear]") {
+	generation_map<int> hm1(64);
+	for (int round = 0; round < 200; round++) {
+		REQUIRE(hm1.empty());
+		REQUIRE(hm1.begin() == hm1.end());
+		for (int i = 0; i < 8; i++) {
+			REQUIRE(!hm1.contains(round + i));
+			hm1[round + i] = round;
+		}
+		hm1.erase(round);
+		REQUIRE(hm1.size() == 7);
+		REQUIRE(hm1.at(round + 7) == round);
+		REQUIRE(std::distance(hm1.begin(), hm1.end()) == 7);
+		hm1.clear();
+	}
+	REQUIRE(hm1.bucket_count() == 64);
+
+	generation_map<string> hm2;
+	for (int round = 0; round < 100; round++) {
+		for (int i = 0; i < 100; i++) {
+			hm2[i] = std::to_string(round * i);
+		}
+		hm2.clear();
+		REQUIRE(hm2.size() == 0);
+		REQUIRE(hm2.find(5) == hm2.end());
+	}
+	hm2[5] = "five";
+	generation_map<string> hm3(hm2);
+	REQUIRE(hm3.at(5) == "five");
+	REQUIRE(hm3.size() == 1);
+
+	generation_map<string> hm4(std::move(hm3));
+	hm3.clear();
+	REQUIRE(hm3.size() == 0);
+}
+
+TEST_CASE("scan", "[scan]") {
+	growth_map<fefu::power_of_two_growth> hm1;
+	REQUIRE(hm1.scan(0, 10, [](pair<const int, int>&) {}) == 0);
+	for (int i = 0; i < 1000; i++) {
+		hm1.insert({ i, i });
+	}
+
+	std::vector<int> seen(1000, 0);
+	size_t cursor = 0;
+	size_t calls = 0;
+	do {
+		cursor = hm1.scan(cursor, 100, [&](pair<const int, int>& x) { seen[x.first]++; });
+		calls++;
+	} while (cursor != 0);
+	REQUIRE(calls > 1);
+	for (int i = 0; i < 1000; i++) {
+		REQUIRE(seen[i] == 1);
+	}
+}
+
+TEST_CASE("scan across growth and shrink", "[scan]") {
+	growth_map<fefu::power_of_two_growth> hm1;
+	hm1.min_load_factor(0.05f);
+	for (int i = 0; i < 1000; i++) {
+		hm1.insert({ i, i });
+	}
+
+	// keys below 500 stay for the whole scan, the others come and go.
+	std::set<int> seen;
+	std::set<size_t> bucket_counts;
+	size_t cursor = 0;
+	int step = 0;
+	do {
+		cursor = hm1.scan(cursor, 20, [&](pair<const int, int>& x) { seen.insert(x.first); });
+		bucket_counts.insert(hm1.bucket_count());
+		if (step < 10) {
+			for (int i = 0; i < 1000; i++) {
+				hm1.insert({ 10000 + step * 1000 + i, 0 });
+			}
+		} else if (step < 20) {
+			for (int i = 0; i < 1000; i++) {
+				hm1.erase(10000 + (step - 10) * 1000 + i);
+			}
+			for (int i = 500 + (step - 10) * 50; i < 550 + (step - 10) * 50; i++) {
+				hm1.erase(i);
+			}
+		}
+		step++;
+	} while (cursor != 0);
+
+	REQUIRE(bucket_counts.size() > 2);
+	for (int i = 0; i < 500; i++) {
+		REQUIRE(seen.count(i) == 1);
+	}
+}
+
+TEST_CASE("slot handles", "[handle]") {
+	hash_map<std::string, int> hm1;
+	for (int i = 0; i < 100; i++) {
+		hm1[std::to_string(i)] = i;
+	}
+
+	fefu::slot_handle handle = hm1.handle(hm1.find("42"));
+	REQUIRE(hm1.get(handle, "42")->second == 42);
+	hm1.get(handle, "42")->second = -42;
+	REQUIRE(hm1.at("42") == -42);
+	REQUIRE(hm1.get(handle, "43")->second == 43);
+	REQUIRE(handle.index == hm1.handle(hm1.find("43")).index);
+
+	// a stale handle falls back to find and is refreshed.
+	size_t generation = hm1.table_generation();
+	hm1.rehash(1000);
+	REQUIRE(hm1.table_generation() != generation);
+	REQUIRE(handle.generation != hm1.table_generation());
+	REQUIRE(hm1.get(handle, "43")->second == 43);
+	REQUIRE(handle.generation == hm1.table_generation());
+
+	// an erased key isn't found through its handle, nor a key that took the slot.
+	hm1.erase("43");
+	REQUIRE(hm1.get(handle, "43") == hm1.end());
+	REQUIRE(handle.index == hm1.bucket_count());
+	fefu::slot_handle missing;
+	REQUIRE(hm1.get(missing, "missing") == hm1.end());
+
+	const auto& chm1 = hm1;
+	fefu::slot_handle first = hm1.handle(hm1.find("0"));
+	hm1.clear();
+	REQUIRE(chm1.get(first, "0") == chm1.end());
+	hm1["0"] = 7;
+	REQUIRE(chm1.get(first, "0")->second == 7);
+}
+
+#if defined(FEFU_HAS_COROUTINES)
+fefu::lookup_task follow_chain(hash_map<int, int>& hm, int key, int steps, int& out) {
+	for (int i = 0; i < steps; i++) {
+		auto iter = co_await fefu::async_find(hm, key);
+		if (iter == hm.end()) {
+			throw std::out_of_range("broken chain");
+		}
+		key = iter->second;
+	}
+	out = key;
+}
+
+fefu::lookup_task insert_more(hash_map<int, int>& hm, int first, int count) {
+	for (int i = first; i < first + count; i++) {
+		co_await fefu::async_find(hm, i);
+		hm.insert({ i, i });
+	}
+}
+
+TEST_CASE("async find", "[async]") {
+	hash_map<int, int> hm1;
+	for (int i = 0; i < 1000; i++) {
+		hm1[i] = (i * 7 + 1) % 1000;
+	}
+
+	std::vector<int> results(50, -1);
+	fefu::lookup_scheduler scheduler;
+	for (int t = 0; t < 50; t++) {
+		scheduler.spawn(follow_chain(hm1, t, 10, results[t]));
+	}
+	// grows the table while the chains are suspended.
+	scheduler.spawn(insert_more(hm1, 1000, 5000));
+	REQUIRE(scheduler.size() == 51);
+	scheduler.run();
+	REQUIRE(scheduler.size() == 0);
+	REQUIRE(hm1.size() == 6000);
+
+	for (int t = 0; t < 50; t++) {
+		int key = t;
+		for (int i = 0; i < 10; i++) {
+			key = (key * 7 + 1) % 1000;
+		}
+		REQUIRE(results[t] == key);
+	}
+
+	int out = 0;
+	scheduler.spawn(follow_chain(hm1, 0, 1, out));
+	scheduler.spawn(follow_chain(hm1, -1, 1, out));
+	REQUIRE_THROWS_AS(scheduler.run(), std::out_of_range);
+	scheduler.run();
+	REQUIRE(out == 1);
+}
+#endif
+
+TEST_CASE("hash join", "[join]") {
+	std::mt19937_64 rng(11);
+	std::vector<pair<uint64_t, int>> build;
+	std::vector<pair<uint64_t, int>> probe;
+	for (int i = 0; i < 200000; i++) {
+		build.push_back({ rng() % 150000, i });
+		probe.push_back({ rng() % 300000, -i });
+	}
+
+	std::unordered_multimap<uint64_t, int> reference(build.begin(), build.end());
+	uint64_t expected_count = 0;
+	uint64_t expected_sum = 0;
+	for (auto& x : probe) {
+		auto range = reference.equal_range(x.first);
+		for (auto iter = range.first; iter != range.second; ++iter) {
+			expected_count++;
+			expected_sum += x.first ^ (static_cast<uint64_t>(iter->second) << 32 | static_cast<uint32_t>(x.second));
+		}
+	}
+
+	for (size_t threads : { 1, 4 }) {
+		for (unsigned bits : { 0u, 1u, 6u }) {
+			fefu::hash_join_options options;
+			options.threads = threads;
+			options.radix_bits = bits;
+			// Catch assertions aren't thread-safe, the workers only count.
+			std::vector<uint64_t> counts(threads * 8, 0);
+			std::vector<uint64_t> sums(threads * 8, 0);
+			fefu::hash_join(build, probe, [&](size_t worker, uint64_t key, int b, int p) {
+				counts[worker * 8]++;
+				sums[worker * 8] += key ^ (static_cast<uint64_t>(b) << 32 | static_cast<uint32_t>(p));
+			}, options, fefu::hash<uint64_t>());
+			uint64_t count = 0;
+			uint64_t sum = 0;
+			for (size_t w = 0; w < threads; w++) {
+				count += counts[w * 8];
+				sum += sums[w * 8];
+			}
+			REQUIRE(count == expected_count);
+			REQUIRE(sum == expected_sum);
+		}
+	}
+}
+
+TEST_CASE("hash join on strings", "[join]") {
+	std::vector<pair<std::string, int>> build;
+	std::vector<pair<std::string, std::string>> probe;
+	for (int i = 0; i < 1000; i++) {
+		build.push_back({ "user" + std::to_string(i), i });
+	}
+	for (int i = 0; i < 3000; i += 2) {
+		probe.push_back({ "user" + std::to_string(i), "order" + std::to_string(i) });
+	}
+
+	std::vector<std::string> matches;
+	fefu::hash_join(build, probe, [&](size_t, const std::string& key, int b, const std::string& p) {
+		REQUIRE(key == "user" + std::to_string(b));
+		REQUIRE(p == "order" + std::to_string(b));
+		matches.push_back(key);
+	}, fefu::hash_join_options(), fefu::hash<std::string>());
+	REQUIRE(matches.size() == 500);
+	REQUIRE(std::set<std::string>(matches.begin(), matches.end()).size() == 500);
+
+	std::vector<pair<std::string, int>> empty;
+	fefu::hash_join(build, empty, [](size_t, const std::string&, int, int) { FAIL(); });
+}
+
+TEST_CASE("hash join after a reseed", "[join]") {
+	// every key collides until the build map's probe guard reseeds it.
+	std::vector<pair<int, int>> build;
+	std::vector<pair<int, int>> probe;
+	for (int i = 0; i < 2000; i++) {
+		build.push_back({ i, i });
+		build.push_back({ i % 100, -i });
+		probe.push_back({ i, i });
+	}
+
+	fefu::hash_join_options options;
+	options.threads = 1;
+	size_t count = 0;
+	bool matched = true;
+	fefu::hash_join(build, probe, [&](size_t, int key, int b, int p) {
+		matched = matched && key == p && (b == key || -b % 100 == key);
+		count++;
+	}, options, colliding_hash());
+	REQUIRE(matched);
+	REQUIRE(count == 4000);
+}
+
+TEST_CASE("small map stays inline", "[small]") {
+	fefu::small_hash_map<int, int, 8> sm1;
+	REQUIRE(sm1.empty());
+	REQUIRE(sm1.begin() == sm1.end());
+
+	for (int i = 0; i < 8; i++) {
+		REQUIRE(sm1.insert({ i, i * 10 }).second);
+	}
+	REQUIRE(!sm1.insert({ 3, 0 }).second);
+	REQUIRE(sm1.is_inline());
+	REQUIRE(sm1.size() == 8);
+	REQUIRE(sm1.at(3) == 30);
+	REQUIRE(!sm1.contains(8));
+	REQUIRE(std::distance(sm1.begin(), sm1.end()) == 8);
+
+	REQUIRE(sm1.erase(0) == 1);
+	REQUIRE(sm1.erase(0) == 0);
+	REQUIRE(sm1.at(7) == 70);
+	sm1[100] = 1000;
+	REQUIRE(sm1.is_inline());
+	REQUIRE(sm1.size() == 8);
+
+	auto iter = sm1.begin();
+	while (iter != sm1.end()) {
+		iter = iter->first % 2 == 0 ? sm1.erase(iter) : std::next(iter);
+	}
+	REQUIRE(sm1.size() == 4);
+	for (int i = 1; i < 8; i += 2) {
+		REQUIRE(sm1.at(i) == i * 10);
+	}
+	REQUIRE_THROWS_AS(sm1.at(2), std::out_of_range);
+}
+
+TEST_CASE("small map spills", "[small]") {
+	fefu::small_hash_map<string, string, 4> sm1;
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(sm1.try_emplace(std::to_string(i), std::to_string(i * i)).second);
+		REQUIRE(sm1.is_inline() == (i < 4));
+	}
+	REQUIRE(sm1.size() == 100);
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(sm1.at(std::to_string(i)) == std::to_string(i * i));
+	}
+
+	fefu::small_hash_map<string, string, 4> sm2(sm1);
+	sm1.clear();
+	REQUIRE(sm1.empty());
+	REQUIRE(sm2.size() == 100);
+	REQUIRE(sm2["99"] == "9801");
+
+	fefu::small_hash_map<string, string, 4> sm3{ { "a", "1" }, { "b", "2" } };
+	fefu::small_hash_map<string, string, 4> sm4(std::move(sm3));
+	REQUIRE(sm3.empty());
+	REQUIRE(sm4.size() == 2);
+	REQUIRE(sm4.insert_or_assign("a", "3").second == false);
+	REQUIRE(sm4.at("a") == "3");
+	sm4.swap(sm2);
+	REQUIRE(sm4.size() == 100);
+	REQUIRE(sm2.size() == 2);
+	REQUIRE(sm2.is_inline());
+}
+
+TEST_CASE("small map move-only values", "[small]") {
+	fefu::small_hash_map<int, std::unique_ptr<int>, 2> sm1;
+	for (int i = 0; i < 10; i++) {
+		sm1.emplace(i, std::make_unique<int>(i));
+	}
+	REQUIRE(!sm1.is_inline());
+	for (int i = 0; i < 10; i++) {
+		REQUIRE(*sm1.at(i) == i);
+	}
+}
+
+constexpr fefu::static_hash_map<int, int, 16> make_squares() {
+	fefu::static_hash_map<int, int, 16> sm;
+	for (int i = 0; i < 12; i++) {
+		sm[i] = i * i;
+	}
+	sm.erase(3);
+	return sm;
+}
+
+TEST_CASE("static map is constexpr", "[static]") {
+	constexpr auto squares = make_squares();
+	static_assert(squares.size() == 11);
+	static_assert(squares.at(11) == 121);
+	static_assert(!squares.contains(3));
+
+	constexpr fefu::static_hash_map<int, int, 4> sm1{ { 1, 10 }, { 2, 20 } };
+	static_assert(sm1.at(2) == 20);
+	REQUIRE(std::distance(sm1.begin(), sm1.end()) == 2);
+}
+
+TEST_CASE("static map fails when full", "[static]") {
+	fefu::static_hash_map<int, string, 8> sm1;
+	for (int i = 0; i < 8; i++) {
+		REQUIRE(sm1.try_emplace(i, std::to_string(i)).second);
+	}
+	auto result = sm1.try_emplace(100, "x");
+	REQUIRE(!result.second);
+	REQUIRE(result.first == sm1.end());
+	REQUIRE(sm1.try_emplace(5, "y").first->second == "5");
+	REQUIRE_THROWS_AS(sm1[100], std::runtime_error);
+	REQUIRE_THROWS_AS(sm1.at(100), std::out_of_range);
+
+	REQUIRE(sm1.erase(5) == 1);
+	REQUIRE(sm1.insert({ 100, "x" }).second);
+	REQUIRE(sm1.size() == 8);
+	sm1.clear();
+	REQUIRE(sm1.empty());
+	REQUIRE(sm1.begin() == sm1.end());
+}
+
+TEST_CASE("static map erase shifts back", "[static]") {
+	std::mt19937 rng(7);
+	fefu::static_hash_map<int, int, 64> sm1;
+	std::unordered_map<int, int> reference;
+	for (int i = 0; i < 20000; i++) {
+		int key = static_cast<int>(rng() % 96);
+		if (rng() % 2 == 0) {
+			bool inserted = sm1.insert({ key, i }).second;
+			if (reference.size() < 64 || reference.count(key) != 0) {
+				REQUIRE(inserted == reference.insert({ key, i }).second);
+			}
+		} else {
+			REQUIRE(sm1.erase(key) == reference.erase(key));
+		}
+		REQUIRE(sm1.size() == reference.size());
+	}
+	for (auto& x : reference) {
+		REQUIRE(sm1.at(x.first) == x.second);
+	}
+	for (auto iter = sm1.begin(); iter != sm1.end(); ++iter) {
+		REQUIRE(reference.at(iter->first) == iter->second);
+	}
+}
+
+struct tens_hash {
+	using is_avalanching = void;
+
+	constexpr size_t operator()(int k) const { return static_cast<size_t>(k / 10); }
+};
+
+TEST_CASE("static map erase while iterating a wrapped cluster", "[static]") {
+	// 70..73 all start at the last slot, so the cluster wraps to slots 0..2.
+	fefu::static_hash_map<int, int, 8, tens_hash> sm1;
+	for (int k : { 70, 71, 72, 73, 10 }) {
+		sm1[k] = k;
+	}
+
+	std::vector<int> visited;
+	for (auto iter = sm1.cbegin(); iter != sm1.cend();) {
+		visited.push_back(iter->first);
+		iter = (iter->first == 70 ? sm1.erase(iter) : std::next(iter));
+	}
+	std::sort(visited.begin(), visited.end());
+	REQUIRE(visited == std::vector<int>{ 10, 70, 71, 72, 73 });
+	REQUIRE(sm1.size() == 4);
+	for (int k : { 71, 72, 73, 10 }) {
+		REQUIRE(sm1.at(k) == k);
+	}
+
+	visited.clear();
+	for (auto iter = sm1.cbegin(); iter != sm1.cend();) {
+		visited.push_back(iter->first);
+		iter = sm1.erase(iter);
+	}
+	REQUIRE(visited.size() == 4);
+	REQUIRE(sm1.empty());
+
+	// tombstones are reused, up to a full map.
+	for (int k = 0; k < 8; k++) {
+		REQUIRE(sm1.insert({ 70 + k, k }).second);
+	}
+	for (int k = 0; k < 8; k++) {
+		REQUIRE(sm1.at(70 + k) == k);
+	}
+	REQUIRE(sm1.erase(72) == 1);
+	REQUIRE(sm1.insert({ 30, 30 }).second);
+	REQUIRE(sm1.size() == 8);
+	REQUIRE(sm1.at(77) == 7);
+}
+
+constexpr auto opcodes = fefu::make_perfect_hash_map<std::string_view, int>({
+	{ "add", 1 }, { "sub", 2 }, { "mul", 3 }, { "div", 4 }, { "mod", 5 },
+	{ "and", 6 }, { "or", 7 }, { "xor", 8 }, { "shift_left", 9 }, { "shift_right", 10 } });
+
+TEST_CASE("perfect hash map", "[perfect]") {
+	static_assert(opcodes.size() == 10);
+	static_assert(opcodes.at("xor") == 8);
+	static_assert(opcodes.contains("shift_right"));
+	static_assert(!opcodes.contains("shift"));
+
+	REQUIRE(opcodes.at(string("mod")) == 5);
+	REQUIRE(opcodes.find("nop") == opcodes.end());
+	REQUIRE(opcodes.find("div")->second == 4);
+	REQUIRE_THROWS_AS(opcodes.at("nop"), std::out_of_range);
+
+	int sum = 0;
+	for (auto x : opcodes) {
+		REQUIRE(opcodes.at(x.first) == x.second);
+		sum += x.second;
+	}
+	REQUIRE(sum == 55);
+}
+
+template <std::size_t N>
+constexpr fefu::perfect_hash_map<uint64_t, uint64_t, N> make_strided_perfect() {
+	std::pair<uint64_t, uint64_t> entries[N] = {};
+	for (std::size_t i = 0; i < N; i++) {
+		entries[i].first = i * 4096;
+		entries[i].second = i;
+	}
+	return fefu::perfect_hash_map<uint64_t, uint64_t, N>(entries);
+}
+
+TEST_CASE("perfect hash map over integers", "[perfect]") {
+	constexpr auto pm1 = make_strided_perfect<300>();
+	for (uint64_t i = 0; i < 300; i++) {
+		REQUIRE(pm1.at(i * 4096) == i);
+		REQUIRE(!pm1.contains(i * 4096 + 1));
+	}
+
+	auto pm2 = make_strided_perfect<2000>();
+	for (uint64_t i = 0; i < 2000; i++) {
+		REQUIRE(pm2.count(i * 4096) == 1);
+	}
+
+	std::pair<int, int> duplicates[3] = { { 1, 1 }, { 2, 2 }, { 1, 3 } };
+	REQUIRE_THROWS_AS((fefu::perfect_hash_map<int, int, 3>(duplicates)), std::runtime_error);
+}
+
+TEST_CASE("freeze", "[freeze]") {
+	hash_map<int, string> hm1;
+	for (int i = 0; i < 1000; i++) {
+		hm1[i * 3] = std::to_string(i);
+	}
+	for (int i = 0; i < 1000; i += 2) {
+		hm1.erase(i * 3);
+	}
+
+	auto fm1 = hm1.freeze();
+	REQUIRE(fm1.size() == 500);
+	REQUIRE(hm1.size() == 500);
+	for (int i = 0; i < 3000; i++) {
+		REQUIRE(fm1.count(i) == hm1.count(i));
+	}
+	REQUIRE(fm1.at(3) == "1");
+	REQUIRE_THROWS_AS(fm1.at(0), std::out_of_range);
+	REQUIRE(fm1.find(6) == fm1.end());
+
+	int visited = 0;
+	for (auto& x : fm1) {
+		REQUIRE(hm1.at(x.first) == x.second);
+		visited++;
+	}
+	REQUIRE(visited == 500);
+	REQUIRE(fm1.memory_usage() < 500 * (sizeof(pair<const int, string>) + 8));
+
+	auto fm2 = hash_map<int, int>().freeze();
+	REQUIRE(fm2.empty());
+	REQUIRE(!fm2.contains(0));
+}
+
+TEST_CASE("freeze keeps the seed", "[freeze]") {
+	hash_map<string, int, fefu::seeded_hash<string>> hm1;
+	for (int i = 0; i < 100; i++) {
+		hm1[std::to_string(i)] = i;
+	}
+	auto fm1 = hm1.freeze();
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(fm1.at(std::to_string(i)) == i);
+	}
+}
+
+TEST_CASE("dense map", "[dense]") {
+	fefu::dense_hash_map<uint64_t, uint64_t> dm1(~0ull, ~0ull - 1);
+	REQUIRE(dm1.empty());
+	REQUIRE(dm1.find(5) == dm1.end());
+	REQUIRE(dm1.begin() == dm1.end());
+
+	for (uint64_t i = 0; i < 1000; i++) {
+		REQUIRE(dm1.insert({ i * 3, i }).second);
+	}
+	REQUIRE(!dm1.insert({ 3, 0 }).second);
+	REQUIRE(dm1.size() == 1000);
+	REQUIRE(dm1.load_factor() <= 0.5f);
+	for (uint64_t i = 0; i < 3000; i++) {
+		REQUIRE(dm1.count(i) == (i % 3 == 0 ? 1 : 0));
+	}
+	REQUIRE(!dm1.contains(~0ull));
+	REQUIRE_THROWS_AS(dm1[~0ull], std::runtime_error);
+	REQUIRE_THROWS_AS(dm1.insert({ ~0ull - 1, 0 }), std::runtime_error);
+
+	for (uint64_t i = 0; i < 1000; i += 2) {
+		REQUIRE(dm1.erase(i * 3) == 1);
+	}
+	REQUIRE(dm1.erase(0) == 0);
+	REQUIRE(dm1.size() == 500);
+	REQUIRE(dm1.at(3) == 1);
+	REQUIRE(std::distance(dm1.begin(), dm1.end()) == 500);
+
+	fefu::dense_hash_map<uint64_t, uint64_t> dm2(dm1);
+	dm1.clear();
+	REQUIRE(dm1.empty());
+	REQUIRE(dm2.size() == 500);
+	dm2.insert_or_assign(3, 30);
+	REQUIRE(dm2.at(3) == 30);
+
+	fefu::dense_hash_map<uint64_t, uint64_t> dm3(std::move(dm2));
+	REQUIRE(dm2.empty());
+	REQUIRE(dm3.size() == 500);
+	REQUIRE_THROWS_AS((fefu::dense_hash_map<int, int>(0, 0)), std::runtime_error);
+}
+
+TEST_CASE("dense map churn", "[dense]") {
+	std::mt19937_64 rng(11);
+	fefu::dense_hash_map<uint64_t, string> dm1(0, 1);
+	std::unordered_map<uint64_t, string> reference;
+	for (int i = 0; i < 50000; i++) {
+		uint64_t key = 2 + rng() % 4000;
+		if (rng() % 3 == 0) {
+			REQUIRE(dm1.erase(key) == reference.erase(key));
+		} else {
+			dm1[key] = std::to_string(i);
+			reference[key] = std::to_string(i);
+		}
+	}
+	REQUIRE(dm1.size() == reference.size());
+	for (auto& x : reference) {
+		REQUIRE(dm1.at(x.first) == x.second);
+	}
+	for (auto& x : dm1) {
+		REQUIRE(reference.at(x.first) == x.second);
+	}
+}
+
+TEST_CASE("compact map", "[compact]") {
+	REQUIRE(fefu::detail::unmix64(fefu::detail::fmix64(0x123456789abcdefull)) == 0x123456789abcdefull);
+
+	fefu::compact_hash_map<uint32_t> cm1;
+	REQUIRE(cm1.empty());
+	REQUIRE(cm1.find(0) == cm1.end());
+	for (uint64_t i = 0; i < 100000; i++) {
+		REQUIRE(cm1.insert({ i * 0x9E3779B97F4A7C15ull, static_cast<uint32_t>(i) }).second);
+	}
+	REQUIRE(!cm1.insert({ 0, 5 }).second);
+	REQUIRE(cm1.size() == 100000);
+	REQUIRE(cm1.load_factor() <= 0.875f);
+	for (uint64_t i = 0; i < 100000; i++) {
+		REQUIRE(cm1.at(i * 0x9E3779B97F4A7C15ull) == i);
+		REQUIRE(!cm1.contains(i * 0x9E3779B97F4A7C15ull + 1));
+	}
+	REQUIRE_THROWS_AS(cm1.at(1), std::out_of_range);
+	REQUIRE(cm1.memory_usage() < 100000 * 16);
+
+	uint64_t sum = 0;
+	std::size_t visited = 0;
+	for (auto x : cm1) {
+		REQUIRE(x.first == x.second * 0x9E3779B97F4A7C15ull);
+		sum += x.second;
+		visited++;
+	}
+	REQUIRE(visited == 100000);
+	REQUIRE(sum == 99999ull * 100000 / 2);
+
+	REQUIRE(!cm1.insert_or_assign(0, 7).second);
+	REQUIRE(cm1.find(0)->second == 7);
+	cm1.clear();
+	REQUIRE(cm1.empty());
+	REQUIRE(cm1.begin() == cm1.end());
+}
+
+TEST_CASE("compact map churn", "[compact]") {
+	std::mt19937_64 rng(5);
+	fefu::compact_hash_map<uint16_t, 12> cm1;
+	std::unordered_map<uint64_t, uint16_t> reference;
+	for (int i = 0; i < 100000; i++) {
+		uint64_t key = rng() % 5000;
+		if (rng() % 3 == 0) {
+			REQUIRE(cm1.erase(key) == reference.erase(key));
+		} else {
+			uint16_t value = static_cast<uint16_t>(rng() & 0xfff);
+			cm1.insert_or_assign(key, value);
+			reference[key] = value;
+		}
+	}
+	REQUIRE(cm1.size() == reference.size());
+	for (auto& x : reference) {
+		REQUIRE(cm1.at(x.first) == x.second);
+	}
+	for (auto x : cm1) {
+		REQUIRE(reference.at(x.first) == x.second);
+	}
+	cm1.rehash(1);
+	REQUIRE(cm1.size() == reference.size());
+	REQUIRE(cm1.load_factor() <= 0.875f);
+}
+
+TEST_CASE("cow map snapshots", "[cow]") {
+	fefu::cow_hash_map<std::string, int> cow1;
+	for (int i = 0; i < 1000; i++) {
+		cow1[std::to_string(i)] = i;
+	}
+
+	auto cow2 = cow1.snapshot();
+	REQUIRE(cow1.shared());
+	REQUIRE(&cow1.map() == &cow2.map());
+	REQUIRE(cow1 == cow2);
+
+	// reads and misses leave the table shared.
+	REQUIRE(cow1.at("10") == 10);
+	REQUIRE(cow1.erase("missing") == 0);
+	REQUIRE(cow1.shared());
+
+	cow1["10"] = -10;
+	cow1.erase("11");
+	cow1.insert({ "1000", 1000 });
+	REQUIRE(!cow1.shared());
+	REQUIRE(!cow2.shared());
+	REQUIRE(&cow1.map() != &cow2.map());
+	REQUIRE(cow1 != cow2);
+
+	REQUIRE(cow2.size() == 1000);
+	REQUIRE(cow2.at("10") == 10);
+	REQUIRE(cow2.contains("11"));
+	REQUIRE(!cow2.contains("1000"));
+	REQUIRE(cow1.size() == 1000);
+	REQUIRE(cow1.at("10") == -10);
+	REQUIRE(!cow1.contains("11"));
+
+	// a further write to the private copy doesn't clone again.
+	const auto* table = &cow1.map();
+	cow1["12"] = 0;
+	REQUIRE(&cow1.map() == table);
+}
+
+TEST_CASE("cow map clear and move", "[cow]") {
+	fefu::cow_hash_map<int, int> cow1{ { 1, 1 }, { 2, 2 }, { 3, 3 } };
+	fefu::cow_hash_map<int, int> cow2 = cow1;
+	cow1.clear();
+	REQUIRE(cow1.empty());
+	REQUIRE(cow2.size() == 3);
+
+	// clearing a shared table keeps the hasher and the load factors.
+	hash_map<int, int, fefu::seeded_hash<int>> seeded(16);
+	seeded.max_load_factor(0.8f);
+	seeded.min_load_factor(0.1f);
+	seeded[1] = 1;
+	auto seed = seeded.hash_function();
+	fefu::cow_hash_map<int, int, fefu::seeded_hash<int>> cow4(std::move(seeded));
+	auto cow5 = cow4.snapshot();
+	cow4.clear();
+	REQUIRE(cow4.empty());
+	REQUIRE(cow5.size() == 1);
+	REQUIRE(cow4.hash_function() == seed);
+	REQUIRE(cow4.map().max_load_factor() == 0.8f);
+	REQUIRE(cow4.map().min_load_factor() == 0.1f);
+
+	fefu::cow_hash_map<int, int> cow3 = std::move(cow2);
+	REQUIRE(cow3.size() == 3);
+	REQUIRE(cow2.size() == 3);
+	cow2[4] = 4;
+	REQUIRE(cow2.size() == 4);
+	REQUIRE(cow3.size() == 3);
+
+	int sum = 0;
+	for (auto& x : cow3) {
+		sum += x.second;
+	}
+	REQUIRE(sum == 6);
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	/// Seeded hash usable in constant expressions, as perfect_hash_map needs
+	/// to evaluate it while building the table at compile time.
+	template <typename K, typename = void>
+	struct perfect_hash;
+
+	template <typename K>
+	struct perfect_hash<K, std::enable_if_t<std::is_integral_v<K> || std::is_enum_v<K>>> {
+		constexpr uint64_t operator()(K k, uint64_t seed) const noexcept {
+			return detail::mix64(static_cast<uint64_t>(k) ^ seed);
+		}
+	};
+
+	template <>
+	struct perfect_hash<std::string_view> {
+		constexpr uint64_t operator()(std::string_view s, uint64_t seed) const noexcept {
+			uint64_t h = seed ^ detail::secret0 ^ s.size();
+			std::size_t i = 0;
+			for (; i + 8 <= s.size(); i += 8) {
+				h = detail::wymix(h ^ read(s, i, 8), detail::secret1);
+			}
+			return detail::wymix(h ^ read(s, i, s.size() - i), detail::secret2);
+		}
+
+	private:
+		///  Little-endian load of n <= 8 bytes, written with shifts so it
+		///  works in constant expressions; compilers fold it into one load.
+		static constexpr uint64_t read(std::string_view s, std::size_t first, std::size_t n) noexcept {
+			uint64_t v = 0;
+			for (std::size_t j = 0; j < n; j++) {
+				v |= static_cast<uint64_t>(static_cast<unsigned char>(s[first + j])) << (8 * j);
+			}
+			return v;
+		}
+	};
+
+	/// Read-only iterator over a perfect_hash_map; every slot holds an element.
+	template <typename Map>
+	class perfect_hash_map_iterator {
+		template <typename K, typename T, std::size_t N, typename Hash, typename Pred>
+		friend class perfect_hash_map;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename Map::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = typename Map::const_reference;
+
+		struct pointer {
+			reference ref;
+
+			constexpr const reference* operator->() const noexcept { return &ref; }
+		};
+
+		constexpr perfect_hash_map_iterator() noexcept = default;
+
+		constexpr reference operator*() const {
+			return reference(map_->keys_[index_], map_->values_[index_]);
+		}
+		constexpr pointer operator->() const {
+			return pointer{ **this };
+		}
+
+		// prefix ++
+		constexpr perfect_hash_map_iterator& operator++() noexcept {
+			index_++;
+			return *this;
+		}
+		// postfix ++
+		constexpr perfect_hash_map_iterator operator++(int) noexcept {
+			perfect_hash_map_iterator result(*this);
+			index_++;
+			return result;
+		}
+
+		friend constexpr bool operator==(const perfect_hash_map_iterator& lhs, const perfect_hash_map_iterator& rhs) {
+			return lhs.index_ == rhs.index_;
+		}
+		friend constexpr bool operator!=(const perfect_hash_map_iterator& lhs, const perfect_hash_map_iterator& rhs) {
+			return lhs.index_ != rhs.index_;
+		}
+
+	private:
+		constexpr perfect_hash_map_iterator(const Map* map, std::size_t index) noexcept : map_(map), index_(index) {}
+
+		const Map* map_ = nullptr;
+		std::size_t index_ = 0;
+	};
+
+	/// Immutable map over a fixed key set, built (usually at compile time)
+	/// with a CHD-style minimal perfect hash: keys are split into buckets of
+	/// about four, and each bucket gets a pilot value that sends all of its
+	/// keys to free slots of a table with exactly N slots. A lookup hashes
+	/// once, reads the bucket's pilot and compares a single slot.
+	///
+	/// Build it with make_perfect_hash_map; duplicate keys are rejected.
+	template <typename K, typename T, std::size_t N, typename Hash = perfect_hash<K>,
+		typename Pred = std::equal_to<K>>
+	class perfect_hash_map {
+		static_assert(N > 0, "perfect_hash_map needs at least one key");
+
+		template <typename>
+		friend class perfect_hash_map_iterator;
+	public:
+		using key_type = K;
+		using mapped_type = T;
+		using hasher = Hash;
+		using key_equal = Pred;
+		using value_type = std::pair<K, T>;
+		using const_reference = std::pair<const key_type&, const mapped_type&>;
+		using size_type = std::size_t;
+		using const_iterator = perfect_hash_map_iterator<perfect_hash_map>;
+		using iterator = const_iterator;
+
+		static constexpr size_type bucket_count = (N + 3) / 4;
+
+		///  Throws std::runtime_error on a duplicate key, or when no perfect
+		///  hash was found, which in a constant expression is a compile error.
+		constexpr explicit perfect_hash_map(const value_type (&entries)[N]) {
+			for (uint64_t attempt = 0; attempt < max_attempts; attempt++) {
+				seed_ = detail::mix64(detail::secret3 + attempt);
+				if (build(entries)) {
+					return;
+				}
+			}
+			throw std::runtime_error("Can't find a perfect hash for these keys");
+		}
+
+		// size and capacity:
+		constexpr bool empty() const noexcept { return false; }
+		static constexpr size_type size() noexcept { return N; }
+
+		// iterators.
+		constexpr const_iterator begin() const noexcept { return const_iterator(this, 0); }
+		constexpr const_iterator end() const noexcept { return const_iterator(this, N); }
+		constexpr const_iterator cbegin() const noexcept { return begin(); }
+		constexpr const_iterator cend() const noexcept { return end(); }
+
+		// lookup.
+		constexpr const_iterator find(const key_type& x) const {
+			return const_iterator(this, find_index(x));
+		}
+
+		constexpr size_type count(const key_type& x) const {
+			return (find_index(x) != N ? 1 : 0);
+		}
+
+		constexpr bool contains(const key_type& x) const {
+			return (this->count(x) == 1);
+		}
+
+		constexpr const mapped_type& at(const key_type& k) const {
+			size_type index = find_index(k);
+			if (index == N) {
+				throw std::out_of_range("Out of range");
+			}
+			return values_[index];
+		}
+
+	private:
+		static constexpr uint64_t max_attempts = 64;
+		static constexpr uint32_t max_pilot = 1 << 20;
+
+		///  Maps x to [0, n) with a multiply instead of a division.
+		static constexpr size_type reduce(uint64_t x, size_type n) noexcept {
+			uint64_t lo = 0, hi = 0;
+			detail::multiply128(x, n, lo, hi);
+			return static_cast<size_type>(hi);
+		}
+
+		static constexpr size_type bucket_of(uint64_t hash) noexcept {
+			return reduce(hash, bucket_count);
+		}
+
+		///  Slot of a key in its bucket's pilot. The pilot is mixed in before
+		///  the reduction: a plain xor would keep keys whose high bits agree
+		///  together for every pilot.
+		static constexpr size_type slot_of(uint64_t hash, uint32_t pilot) noexcept {
+			return reduce(detail::mix64(hash ^ pilot), N);
+		}
+
+		constexpr size_type find_index(const key_type& x) const {
+			uint64_t hash = hasher_(x, seed_);
+			size_type index = slot_of(hash, pilots_[bucket_of(hash)]);
+			return (pred_(keys_[index], x) ? index : N);
+		}
+
+		///  One CHD attempt with the current seed: places the biggest buckets
+		///  first while the table is still empty. Returns false when the seed
+		///  has to change.
+		constexpr bool build(const value_type (&entries)[N]) {
+			std::array<uint64_t, N> hashes{};
+			std::array<size_type, bucket_count + 1> first{};
+			for (size_type i = 0; i < N; i++) {
+				hashes[i] = hasher_(entries[i].first, seed_);
+				first[bucket_of(hashes[i]) + 1]++;
+			}
+
+			size_type largest = 0;
+			for (size_type b = 0; b < bucket_count; b++) {
+				largest = (first[b + 1] > largest ? first[b + 1] : largest);
+				first[b + 1] += first[b];
+			}
+
+			// bucket members, grouped by bucket.
+			std::array<size_type, N> members{};
+			std::array<size_type, bucket_count> fill{};
+			for (size_type i = 0; i < N; i++) {
+				size_type b = bucket_of(hashes[i]);
+				members[first[b] + fill[b]++] = i;
+			}
+
+			std::array<bool, N> taken{};
+			pilots_ = {};
+			for (size_type length = largest; length > 0; length--) {
+				for (size_type b = 0; b < bucket_count; b++) {
+					if (fill[b] == length && !place(entries, hashes, members, first[b], length, taken, b)) {
+						return false;
+					}
+				}
+			}
+
+			for (size_type i = 0; i < N; i++) {
+				size_type index = slot_of(hashes[i], pilots_[bucket_of(hashes[i])]);
+				keys_[index] = entries[i].first;
+				values_[index] = entries[i].second;
+			}
+			return true;
+		}
+
+		///  Searches a pilot that sends every key of bucket b to a free slot.
+		constexpr bool place(const value_type (&entries)[N], const std::array<uint64_t, N>& hashes,
+			const std::array<size_type, N>& members, size_type first, size_type length,
+			std::array<bool, N>& taken, size_type b) {
+			for (size_type i = first; i < first + length; i++) {
+				for (size_type j = first; j < i; j++) {
+					if (hashes[members[i]] == hashes[members[j]]) {
+						if (pred_(entries[members[i]].first, entries[members[j]].first)) {
+							throw std::runtime_error("Duplicate key in perfect_hash_map");
+						}
+						return false;
+					}
+				}
+			}
+
+			for (uint32_t pilot = 0; pilot < max_pilot; pilot++) {
+				size_type placed = 0;
+				while (placed < length) {
+					size_type index = slot_of(hashes[members[first + placed]], pilot);
+					if (taken[index]) {
+						break;
+					}
+					taken[index] = true;
+					placed++;
+				}
+				if (placed == length) {
+					pilots_[b] = pilot;
+					return true;
+				}
+				// release the slots this pilot took before the collision.
+				for (size_type i = 0; i < placed; i++) {
+					taken[slot_of(hashes[members[first + i]], pilot)] = false;
+				}
+			}
+			return false;
+		}
+
+		uint64_t seed_ = 0;
+		std::array<uint32_t, bucket_count> pilots_{};
+		std::array<key_type, N> keys_{};
+		std::array<mapped_type, N> values_{};
+		FEFU_NO_UNIQUE_ADDRESS hasher hasher_{};
+		FEFU_NO_UNIQUE_ADDRESS key_equal pred_{};
+	};
+
+	/// Builds a perfect_hash_map from a braced list of entries:
+	///
+	///     constexpr auto opcodes = make_perfect_hash_map<std::string_view, int>({
+	///         { "add", 1 }, { "sub", 2 }, { "mul", 3 } });
+	template <typename K, typename T, std::size_t N, typename Hash = perfect_hash<K>,
+		typename Pred = std::equal_to<K>>
+	constexpr perfect_hash_map<K, T, N, Hash, Pred> make_perfect_hash_map(const std::pair<K, T> (&entries)[N]) {
+		return perfect_hash_map<K, T, N, Hash, Pred>(entries);
+	}
+
+}  // namespace fefu
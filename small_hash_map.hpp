@@ -0,0 +1,432 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	/// Iterator of small_hash_map: a pointer into the inline array while the
+	/// map is small, an iterator of the spilled hash_map afterwards.
+	template <typename ValueType, typename LargeIterator>
+	class small_hash_map_iterator {
+		template <typename K, typename T, std::size_t N, typename Hash, typename Pred, typename Alloc>
+		friend class small_hash_map;
+
+		template <typename, typename>
+		friend class small_hash_map_iterator;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::remove_const_t<ValueType>;
+		using difference_type = std::ptrdiff_t;
+		using reference = ValueType&;
+		using pointer = ValueType*;
+
+		small_hash_map_iterator() noexcept = default;
+
+		template <typename _V, typename _L,
+			typename = std::enable_if_t<std::is_convertible_v<_V*, ValueType*>>>
+		small_hash_map_iterator(const small_hash_map_iterator<_V, _L>& other) noexcept
+			: ptr_(other.ptr_), large_(other.large_), spilled_(other.spilled_) {
+		}
+
+		reference operator*() const { return spilled_ ? *large_ : *ptr_; }
+		pointer operator->() const { return spilled_ ? large_.operator->() : ptr_; }
+
+		// prefix ++
+		small_hash_map_iterator& operator++() {
+			if (spilled_) {
+				++large_;
+			} else {
+				++ptr_;
+			}
+			return *this;
+		}
+		// postfix ++
+		small_hash_map_iterator operator++(int) {
+			small_hash_map_iterator result(*this);
+			++(*this);
+			return result;
+		}
+
+		friend bool operator==(const small_hash_map_iterator& lhs, const small_hash_map_iterator& rhs) {
+			return lhs.spilled_ ? lhs.large_ == rhs.large_ : lhs.ptr_ == rhs.ptr_;
+		}
+		friend bool operator!=(const small_hash_map_iterator& lhs, const small_hash_map_iterator& rhs) {
+			return !(lhs == rhs);
+		}
+
+	private:
+		explicit small_hash_map_iterator(pointer ptr) noexcept : ptr_(ptr) {}
+		explicit small_hash_map_iterator(const LargeIterator& large) noexcept : large_(large), spilled_(true) {}
+
+		pointer ptr_ = nullptr;
+		LargeIterator large_;
+		bool spilled_ = false;
+	};
+
+	/// Map that keeps up to N elements inline, without any heap allocation,
+	/// and finds keys with a linear scan (a vector compare for integer and
+	/// pointer keys). Inserting element N + 1 moves everything into a
+	/// hash_map, which the map keeps using until it is destroyed.
+	template <typename K, typename T, std::size_t N = 8, typename Hash = std::hash<K>,
+		typename Pred = std::equal_to<K>,
+		typename Alloc = allocator<std::pair<const K, T>>>
+	class small_hash_map {
+		static_assert(N > 0 && N <= 64, "small_hash_map keeps between 1 and 64 elements inline");
+	public:
+		using key_type = K;
+		using mapped_type = T;
+		using hasher = Hash;
+		using key_equal = Pred;
+		using allocator_type = Alloc;
+		using value_type = std::pair<const key_type, mapped_type>;
+		using reference = value_type&;
+		using const_reference = const value_type&;
+		using size_type = std::size_t;
+		using large_map = hash_map<K, T, Hash, Pred, Alloc>;
+		using iterator = small_hash_map_iterator<value_type, typename large_map::iterator>;
+		using const_iterator = small_hash_map_iterator<const value_type, typename large_map::const_iterator>;
+
+		static constexpr size_type inline_capacity = N;
+
+		small_hash_map() noexcept = default;
+
+		small_hash_map(std::initializer_list<value_type> l) {
+			this->insert(l.begin(), l.end());
+		}
+
+		small_hash_map(const small_hash_map& other) {
+			if (other.large_ != nullptr) {
+				large_ = new large_map(*other.large_);
+			} else {
+				for (size_type i = 0; i < other.size_; i++) {
+					append(other.data()[i]);
+				}
+			}
+		}
+
+		small_hash_map(small_hash_map&& other) {
+			steal(other);
+		}
+
+		~small_hash_map() {
+			destroy();
+		}
+
+		small_hash_map& operator=(const small_hash_map& other) {
+			if (this != &other) {
+				small_hash_map copy(other);
+				destroy();
+				steal(copy);
+			}
+			return *this;
+		}
+
+		small_hash_map& operator=(small_hash_map&& other) {
+			if (this != &other) {
+				destroy();
+				steal(other);
+			}
+			return *this;
+		}
+
+		// size and capacity:
+		bool empty() const noexcept { return size() == 0; }
+		size_type size() const noexcept { return large_ != nullptr ? large_->size() : size_; }
+
+		///  True while the elements live in the inline array.
+		bool is_inline() const noexcept { return large_ == nullptr; }
+
+		// iterators.
+		iterator begin() noexcept {
+			return large_ != nullptr ? iterator(large_->begin()) : iterator(data());
+		}
+		iterator end() noexcept {
+			return large_ != nullptr ? iterator(large_->end()) : iterator(data() + size_);
+		}
+		const_iterator begin() const noexcept { return cbegin(); }
+		const_iterator end() const noexcept { return cend(); }
+		const_iterator cbegin() const noexcept {
+			return large_ != nullptr ? const_iterator(large_->cbegin()) : const_iterator(data());
+		}
+		const_iterator cend() const noexcept {
+			return large_ != nullptr ? const_iterator(large_->cend()) : const_iterator(data() + size_);
+		}
+
+		// modifiers.
+		template <typename... _Args>
+		std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
+			return emplace_key(k, [&](large_map& large) {
+				return large.try_emplace(k, std::forward<_Args>(args)...);
+			}, std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Args>(args)...));
+		}
+
+		template <typename... _Args>
+		std::pair<iterator, bool> try_emplace(key_type&& k, _Args&&... args) {
+			return emplace_key(k, [&](large_map& large) {
+				return large.try_emplace(std::move(k), std::forward<_Args>(args)...);
+			}, std::piecewise_construct, std::forward_as_tuple(std::move(k)), std::forward_as_tuple(std::forward<_Args>(args)...));
+		}
+
+		template <typename... _Args>
+		std::pair<iterator, bool> emplace(_Args&&... args) {
+			if constexpr (detail::is_key_value_args<key_type, _Args...>::value) {
+				return emplace_key_value(std::forward<_Args>(args)...);
+			} else if constexpr (detail::is_key_pair_arg<key_type, _Args...>::value) {
+				return emplace_pair(std::forward<_Args>(args)...);
+			} else {
+				return this->insert(value_type(std::forward<_Args>(args)...));
+			}
+		}
+
+		std::pair<iterator, bool> insert(const value_type& x) {
+			return emplace_pair(x);
+		}
+
+		std::pair<iterator, bool> insert(value_type&& x) {
+			return emplace_pair(std::move(x));
+		}
+
+		template <typename _InputIterator>
+		void insert(_InputIterator first, _InputIterator last) {
+			for (auto iter = first; iter != last; iter++) {
+				this->insert(*iter);
+			}
+		}
+
+		void insert(std::initializer_list<value_type> l) {
+			this->insert(l.begin(), l.end());
+		}
+
+		template <typename _Obj>
+		std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
+			auto result = this->try_emplace(k, std::forward<_Obj>(obj));
+			if (!result.second) {
+				result.first->second = std::forward<_Obj>(obj);
+			}
+			return result;
+		}
+
+		mapped_type& operator[](const key_type& k) {
+			return this->try_emplace(k).first->second;
+		}
+		mapped_type& operator[](key_type&& k) {
+			return this->try_emplace(std::move(k)).first->second;
+		}
+
+		///  Erases the element at position; in the inline array the last
+		///  element moves into its slot, so the returned iterator points to it.
+		iterator erase(const_iterator position) {
+			if (large_ != nullptr) {
+				return iterator(large_->erase(position.large_));
+			}
+			size_type index = static_cast<size_type>(position.ptr_ - data());
+			if (index >= size_) {
+				throw std::runtime_error("Invalid iterator for erase data");
+			}
+			remove_at(index);
+			return iterator(data() + index);
+		}
+
+		size_type erase(const key_type& x) {
+			if (large_ != nullptr) {
+				return large_->erase(x);
+			}
+			size_type index = inline_index(x);
+			if (index == size_) {
+				return 0;
+			}
+			remove_at(index);
+			return 1;
+		}
+
+		///  Destroys the elements; a spilled map keeps its table.
+		void clear() noexcept {
+			if (large_ != nullptr) {
+				large_->clear();
+				return;
+			}
+			for (size_type i = 0; i < size_; i++) {
+				data()[i].~value_type();
+			}
+			size_ = 0;
+		}
+
+		void swap(small_hash_map& x) {
+			small_hash_map tmp(std::move(x));
+			x = std::move(*this);
+			*this = std::move(tmp);
+		}
+
+		// lookup.
+		iterator find(const key_type& x) {
+			if (large_ != nullptr) {
+				return iterator(large_->find(x));
+			}
+			return iterator(data() + inline_index(x));
+		}
+		const_iterator find(const key_type& x) const {
+			if (large_ != nullptr) {
+				return const_iterator(static_cast<const large_map&>(*large_).find(x));
+			}
+			return const_iterator(data() + inline_index(x));
+		}
+
+		size_type count(const key_type& x) const {
+			return (this->find(x) != this->end() ? 1 : 0);
+		}
+
+		bool contains(const key_type& x) const {
+			return (this->count(x) == 1);
+		}
+
+		mapped_type& at(const key_type& k) {
+			auto iter = this->find(k);
+			if (iter == this->end()) {
+				throw std::out_of_range("Out of range");
+			}
+			return iter->second;
+		}
+		const mapped_type& at(const key_type& k) const {
+			auto iter = this->find(k);
+			if (iter == this->end()) {
+				throw std::out_of_range("Out of range");
+			}
+			return iter->second;
+		}
+
+	private:
+		value_type* data() noexcept { return reinterpret_cast<value_type*>(storage_); }
+		const value_type* data() const noexcept { return reinterpret_cast<const value_type*>(storage_); }
+
+		///  Returns the inline index of x, or size_ when it is absent.
+		size_type inline_index(const key_type& x) const {
+			if constexpr (detail::is_scannable_key<K, Pred>::value) {
+				uint64_t mask = 0;
+				for (size_type i = 0; i < N; i++) {
+					mask |= static_cast<uint64_t>(keys_[i] == x) << i;
+				}
+				if (size_ < 64) {
+					mask &= (static_cast<uint64_t>(1) << size_) - 1;
+				}
+				return mask != 0 ? detail::count_trailing_zeros(mask) : size_;
+			} else {
+				for (size_type i = 0; i < size_; i++) {
+					if (pred_(data()[i].first, x)) {
+						return i;
+					}
+				}
+				return size_;
+			}
+		}
+
+		///  Finds or appends key in the inline array; once the array is full,
+		///  spills it and hands the insert to large.
+		template <typename _Large, typename... _Args>
+		std::pair<iterator, bool> emplace_key(const key_type& key, _Large&& large, _Args&&... args) {
+			if (large_ == nullptr) {
+				size_type index = inline_index(key);
+				if (index != size_) {
+					return { iterator(data() + index), false };
+				}
+				if (size_ < N) {
+					append(std::forward<_Args>(args)...);
+					return { iterator(data() + size_ - 1), true };
+				}
+				spill();
+			}
+			auto result = large(*large_);
+			return { iterator(result.first), result.second };
+		}
+
+		template <typename _Kx, typename _V>
+		std::pair<iterator, bool> emplace_key_value(_Kx&& k, _V&& v) {
+			return emplace_key(k, [&](large_map& large) {
+				return large.emplace(std::forward<_Kx>(k), std::forward<_V>(v));
+			}, std::forward<_Kx>(k), std::forward<_V>(v));
+		}
+
+		template <typename _P>
+		std::pair<iterator, bool> emplace_pair(_P&& p) {
+			return emplace_key(p.first, [&](large_map& large) {
+				return large.emplace(std::forward<_P>(p));
+			}, std::forward<_P>(p));
+		}
+
+		template <typename... _Args>
+		void append(_Args&&... args) {
+			new (data() + size_) value_type(std::forward<_Args>(args)...);
+			if constexpr (detail::is_scannable_key<K, Pred>::value) {
+				keys_[size_] = data()[size_].first;
+			}
+			size_++;
+		}
+
+		void remove_at(size_type index) {
+			data()[index].~value_type();
+			size_--;
+			if (index != size_) {
+				new (data() + index) value_type(std::move(data()[size_]));
+				data()[size_].~value_type();
+				if constexpr (detail::is_scannable_key<K, Pred>::value) {
+					keys_[index] = keys_[size_];
+				}
+			}
+		}
+
+		///  Moves the inline elements into a hash_map sized for twice as many.
+		void spill() {
+			large_map* large = new large_map();
+			try {
+				large->reserve(2 * N);
+				for (size_type i = 0; i < size_; i++) {
+					large->insert(std::move(data()[i]));
+				}
+			} catch (...) {
+				delete large;
+				throw;
+			}
+			clear();
+			large_ = large;
+		}
+
+		void destroy() noexcept {
+			if (large_ != nullptr) {
+				delete large_;
+				large_ = nullptr;
+			} else {
+				clear();
+			}
+		}
+
+		///  Takes the elements of other, which must be empty and inline after.
+		void steal(small_hash_map& other) {
+			if (other.large_ != nullptr) {
+				large_ = other.large_;
+				other.large_ = nullptr;
+				return;
+			}
+			for (size_type i = 0; i < other.size_; i++) {
+				append(std::move(other.data()[i]));
+			}
+			other.clear();
+		}
+
+		alignas(value_type) unsigned char storage_[N * sizeof(value_type)];
+		std::conditional_t<detail::is_scannable_key<K, Pred>::value, key_type[N], char> keys_{};
+		size_type size_ = 0;
+		large_map* large_ = nullptr;
+		FEFU_NO_UNIQUE_ADDRESS key_equal pred_;
+	};
+
+}  // namespace fefu
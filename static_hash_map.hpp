@@ -0,0 +1,305 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "hash_map.hpp"
+
+namespace fefu {
+
+	/// Proxy returned by operator-> of the static_hash_map iterators, which
+	/// hand out (key, value) reference pairs instead of stored pairs.
+	template <typename Reference>
+	struct static_hash_map_arrow {
+		Reference ref;
+
+		constexpr Reference* operator->() noexcept { return &ref; }
+	};
+
+	/// Forward iterator over the full slots of a static_hash_map.
+	template <typename Map, typename Reference>
+	class static_hash_map_iterator {
+		template <typename K, typename T, std::size_t Capacity, typename Hash, typename Pred>
+		friend class static_hash_map;
+
+		template <typename, typename>
+		friend class static_hash_map_iterator;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename std::remove_const_t<Map>::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = Reference;
+		using pointer = static_hash_map_arrow<Reference>;
+
+		constexpr static_hash_map_iterator() noexcept = default;
+
+		template <typename _Map, typename _Ref,
+			typename = std::enable_if_t<std::is_convertible_v<_Map*, Map*>>>
+		constexpr static_hash_map_iterator(const static_hash_map_iterator<_Map, _Ref>& other) noexcept
+			: map_(other.map_), index_(other.index_) {
+		}
+
+		constexpr reference operator*() const {
+			return reference(map_->keys_[index_], map_->values_[index_]);
+		}
+		constexpr pointer operator->() const {
+			return pointer{ **this };
+		}
+
+		// prefix ++
+		constexpr static_hash_map_iterator& operator++() {
+			index_ = map_->next_full(index_ + 1);
+			return *this;
+		}
+		// postfix ++
+		constexpr static_hash_map_iterator operator++(int) {
+			static_hash_map_iterator result(*this);
+			++(*this);
+			return result;
+		}
+
+		friend constexpr bool operator==(const static_hash_map_iterator& lhs, const static_hash_map_iterator& rhs) {
+			return lhs.index_ == rhs.index_;
+		}
+		friend constexpr bool operator!=(const static_hash_map_iterator& lhs, const static_hash_map_iterator& rhs) {
+			return lhs.index_ != rhs.index_;
+		}
+
+	private:
+		constexpr static_hash_map_iterator(Map* map, std::size_t index) noexcept : map_(map), index_(index) {}
+
+		Map* map_ = nullptr;
+		std::size_t index_ = 0;
+	};
+
+	/// Open-addressing map with a compile-time power-of-two capacity. Keys,
+	/// values and slot states live in fixed arrays inside the object, so the
+	/// map never allocates and never rehashes; an insert into a full map
+	/// fails instead. Every operation is constexpr when K, T, Hash and Pred
+	/// allow it. Erase shifts the following entries back, so tombstones are
+	/// only left where erasing through an iterator would otherwise pull an
+	/// entry across the end of the table, back into the part still ahead of
+	/// the iterator; inserts reuse them.
+	template <typename K, typename T, std::size_t Capacity, typename Hash = hash<K>,
+		typename Pred = std::equal_to<K>>
+	class static_hash_map {
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+			"static_hash_map capacity must be a power of two");
+		static_assert(std::is_default_constructible_v<K> && std::is_default_constructible_v<T>,
+			"static_hash_map keeps default-constructed keys and values in empty slots");
+
+		template <typename, typename>
+		friend class static_hash_map_iterator;
+	public:
+		using key_type = K;
+		using mapped_type = T;
+		using hasher = Hash;
+		using key_equal = Pred;
+		using value_type = std::pair<K, T>;
+		using reference = std::pair<const key_type&, mapped_type&>;
+		using const_reference = std::pair<const key_type&, const mapped_type&>;
+		using size_type = std::size_t;
+		using iterator = static_hash_map_iterator<static_hash_map, reference>;
+		using const_iterator = static_hash_map_iterator<const static_hash_map, const_reference>;
+
+		constexpr static_hash_map() = default;
+
+		///  Throws std::runtime_error when l has more distinct keys than Capacity.
+		constexpr static_hash_map(std::initializer_list<value_type> l) {
+			for (const value_type& x : l) {
+				if (this->insert(x).first == this->end()) {
+					throw std::runtime_error("static_hash_map is full");
+				}
+			}
+		}
+
+		// size and capacity:
+		constexpr bool empty() const noexcept { return size_ == 0; }
+		constexpr size_type size() const noexcept { return size_; }
+		static constexpr size_type capacity() noexcept { return Capacity; }
+		static constexpr size_type max_size() noexcept { return Capacity; }
+
+		// iterators.
+		constexpr iterator begin() noexcept { return iterator(this, next_full(0)); }
+		constexpr iterator end() noexcept { return iterator(this, Capacity); }
+		constexpr const_iterator begin() const noexcept { return cbegin(); }
+		constexpr const_iterator end() const noexcept { return cend(); }
+		constexpr const_iterator cbegin() const noexcept { return const_iterator(this, next_full(0)); }
+		constexpr const_iterator cend() const noexcept { return const_iterator(this, Capacity); }
+
+		// modifiers.
+		///  Returns the element with key k and true if it was inserted; when
+		///  the map is full and k is absent, returns end() and false.
+		template <typename... _Args>
+		constexpr std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
+			size_type index = probe(k);
+			if (index == Capacity) {
+				return { end(), false };
+			}
+			if (states_[index] == detail::slot_full) {
+				return { iterator(this, index), false };
+			}
+			keys_[index] = k;
+			values_[index] = mapped_type(std::forward<_Args>(args)...);
+			states_[index] = detail::slot_full;
+			size_++;
+			return { iterator(this, index), true };
+		}
+
+		constexpr std::pair<iterator, bool> insert(const value_type& x) {
+			return this->try_emplace(x.first, x.second);
+		}
+
+		template <typename _InputIterator>
+		constexpr void insert(_InputIterator first, _InputIterator last) {
+			for (auto iter = first; iter != last; iter++) {
+				this->insert(*iter);
+			}
+		}
+
+		template <typename _Obj>
+		constexpr std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
+			auto result = this->try_emplace(k);
+			if (result.first != end()) {
+				values_[result.first.index_] = std::forward<_Obj>(obj);
+			}
+			return result;
+		}
+
+		///  Throws std::runtime_error when k is absent and the map is full.
+		constexpr mapped_type& operator[](const key_type& k) {
+			auto result = this->try_emplace(k);
+			if (result.first == end()) {
+				throw std::runtime_error("static_hash_map is full");
+			}
+			return values_[result.first.index_];
+		}
+
+		constexpr size_type erase(const key_type& x) {
+			size_type index = find_index(x);
+			if (index == Capacity) {
+				return 0;
+			}
+			erase_slot(index);
+			return 1;
+		}
+
+		constexpr iterator erase(const_iterator position) {
+			if (position.index_ >= Capacity || states_[position.index_] != detail::slot_full) {
+				throw std::runtime_error("Invalid iterator for erase data");
+			}
+			// the shift may pull a later element into this slot, but none
+			// that the iteration has passed already.
+			erase_slot(position.index_, true);
+			return iterator(this, next_full(position.index_));
+		}
+
+		constexpr void clear() {
+			for (size_type i = 0; i < Capacity; i++) {
+				if (states_[i] == detail::slot_full) {
+					keys_[i] = key_type();
+					values_[i] = mapped_type();
+				}
+				states_[i] = detail::slot_empty;
+			}
+			size_ = 0;
+		}
+
+		// lookup.
+		constexpr iterator find(const key_type& x) { return iterator(this, find_index(x)); }
+		constexpr const_iterator find(const key_type& x) const { return const_iterator(this, find_index(x)); }
+
+		constexpr size_type count(const key_type& x) const {
+			return (find_index(x) != Capacity ? 1 : 0);
+		}
+
+		constexpr bool contains(const key_type& x) const {
+			return (this->count(x) == 1);
+		}
+
+		constexpr mapped_type& at(const key_type& k) {
+			size_type index = find_index(k);
+			if (index == Capacity) {
+				throw std::out_of_range("Out of range");
+			}
+			return values_[index];
+		}
+		constexpr const mapped_type& at(const key_type& k) const {
+			size_type index = find_index(k);
+			if (index == Capacity) {
+				throw std::out_of_range("Out of range");
+			}
+			return values_[index];
+		}
+
+	private:
+		static constexpr size_type mask = Capacity - 1;
+
+		constexpr size_type home(const key_type& k) const {
+			return power_of_two_growth().template index<is_avalanching_v<Hash>>(hasher_(k), Capacity);
+		}
+
+		///  Returns the slot holding k, or the empty slot it would go to;
+		///  Capacity when the map is full and k is absent.
+		constexpr size_type probe(const key_type& k) const {
+			size_type probes = 0;
+			return detail::linear_probe(home(k), Capacity,
+				[this](size_type i) { return states_[i]; },
+				[this, &k](size_type i) { return pred_(keys_[i], k); }, probes);
+		}
+
+		constexpr size_type find_index(const key_type& k) const {
+			size_type index = probe(k);
+			return (index != Capacity && states_[index] == detail::slot_full ? index : Capacity);
+		}
+
+		constexpr size_type next_full(size_type index) const noexcept {
+			while (index < Capacity && states_[index] != detail::slot_full) {
+				index++;
+			}
+			return index;
+		}
+
+		///  Backward-shift deletion: every later entry of the cluster whose home
+		///  doesn't lie between the hole and itself moves into the hole. The
+		///  hole becomes a tombstone when the cluster goes on past it: beyond
+		///  an older tombstone, or when in_order keeps an entry wrapped around
+		///  to before index from moving up behind it.
+		constexpr void erase_slot(size_type index, bool in_order = false) {
+			size_type hole = index;
+			states_[hole] = detail::slot_empty;
+			size_type i = (hole + 1) & mask;
+			for (; states_[i] == detail::slot_full; i = (i + 1) & mask) {
+				size_type distance = (i - home(keys_[i])) & mask;
+				if (distance >= ((i - hole) & mask)) {
+					if (in_order && i < index && hole >= index) {
+						break;
+					}
+					keys_[hole] = std::move(keys_[i]);
+					values_[hole] = std::move(values_[i]);
+					states_[hole] = detail::slot_full;
+					states_[i] = detail::slot_empty;
+					hole = i;
+				}
+			}
+			keys_[hole] = key_type();
+			values_[hole] = mapped_type();
+			states_[hole] = (states_[i] == detail::slot_empty ? detail::slot_empty : detail::slot_deleted);
+			size_--;
+		}
+
+		std::array<key_type, Capacity> keys_{};
+		std::array<mapped_type, Capacity> values_{};
+		std::array<char, Capacity> states_{};
+		size_type size_ = 0;
+		FEFU_NO_UNIQUE_ADDRESS hasher hasher_{};
+		FEFU_NO_UNIQUE_ADDRESS key_equal pred_{};
+	};
+
+}  // namespace fefu